@@ -0,0 +1,70 @@
+/*************************************************************
+TvBufferPool keeps the buffers of the same size for reuse, the uploads read the network into them piece by piece.
+A buffer comes back to the pool when its last shared_ptr is dropped,
+only maximumFree buffers are kept, so the memory does not grow after many parallel uploads.
+**************************************************************/
+
+#ifndef TVPORT_BUFFER_POOL_HPP
+#define TVPORT_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class TvBufferPool
+{
+	std::mutex poolMutex;
+	std::vector<char*> freeBuffers;
+	size_t bufferSize;
+	size_t maximumFree;
+
+	void release(char* buffer)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (freeBuffers.size() < maximumFree)
+		{
+			freeBuffers.push_back(buffer);
+			return;
+		}
+		delete[] buffer;
+	}
+
+public:
+	TvBufferPool(size_t bufferSize, size_t maximumFree) : bufferSize(bufferSize), maximumFree(maximumFree)
+	{
+	}
+
+	~TvBufferPool()
+	{
+		for (char* buffer : freeBuffers)
+		{
+			delete[] buffer;
+		}
+	}
+
+	std::shared_ptr<char> acquire()
+	{
+		char* buffer = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			if (!freeBuffers.empty())
+			{
+				buffer = freeBuffers.back();
+				freeBuffers.pop_back();
+			}
+		}
+		if (buffer == nullptr)
+		{
+			buffer = new char[bufferSize];
+		}
+		return std::shared_ptr<char>(buffer, [this](char* p) { release(p); });
+	}
+
+	size_t getBufferSize()
+	{
+		return bufferSize;
+	}
+};
+
+#endif
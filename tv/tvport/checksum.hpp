@@ -0,0 +1,253 @@
+/*************************************************************
+TvChecksum computes the check sum of the uploaded files: CRC-32C (Castagnoli), written in decimal in the file name
+(i0_<checksum>-<length>.jpg), 0 means that the master did not calculate it and the file is not checked.
+The x64 processors compute CRC-32C by the SSE4.2 crc32 instruction, 8 bytes at a time,
+the table driven version (slicing by 8) is used when the instruction is not available.
+
+The chunks uploaded in order are summed while they arrive, the sums of the chunks are joined by combine,
+so a file is never read again for its check sum. When the chunks came out of order or were sent twice,
+the completed file is read once, in parts by several threads, and the sums of the parts are combined.
+**************************************************************/
+
+#ifndef TVPORT_CHECKSUM_HPP
+#define TVPORT_CHECKSUM_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <nmmintrin.h>
+#define TVPORT_CHECKSUM_SSE42
+#endif
+
+// reflected polynomial of CRC-32C
+#define TVPORT_CHECKSUM_POLYNOMIAL 0x82F63B78u
+#define TVPORT_CHECKSUM_BLOCK_SIZE (1 << 20)
+// a thread of the file pass reads at least so many bytes
+#define TVPORT_CHECKSUM_MINIMUM_PART (16 << 20)
+
+class TvChecksum
+{
+	struct Table {
+		uint32_t values[8][256];
+
+		Table()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+				for (int k = 0; k < 8; k++)
+				{
+					crc = crc & 1 ? (crc >> 1) ^ TVPORT_CHECKSUM_POLYNOMIAL : crc >> 1;
+				}
+				values[0][i] = crc;
+			}
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				for (int k = 1; k < 8; k++)
+				{
+					values[k][i] = (values[k - 1][i] >> 8) ^ values[0][values[k - 1][i] & 0xff];
+				}
+			}
+		}
+	};
+
+	static const Table& getTable()
+	{
+		static const Table table;
+		return table;
+	}
+
+	static uint32_t updateSoftware(uint32_t crc, const unsigned char* p, size_t size)
+	{
+		const Table& t = getTable();
+		while (size >= 8)
+		{
+			uint32_t low, high;
+			memcpy(&low, p, 4);
+			memcpy(&high, p + 4, 4);
+			low ^= crc;
+			crc = t.values[7][low & 0xff] ^ t.values[6][(low >> 8) & 0xff] ^ t.values[5][(low >> 16) & 0xff] ^ t.values[4][low >> 24]
+				^ t.values[3][high & 0xff] ^ t.values[2][(high >> 8) & 0xff] ^ t.values[1][(high >> 16) & 0xff] ^ t.values[0][high >> 24];
+			p += 8;
+			size -= 8;
+		}
+		while (size-- > 0)
+		{
+			crc = (crc >> 8) ^ t.values[0][(crc ^ *p++) & 0xff];
+		}
+		return crc;
+	}
+
+#ifdef TVPORT_CHECKSUM_SSE42
+	static bool hasSse42()
+	{
+		static const bool available = []() {
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 20)) != 0;
+		}();
+		return available;
+	}
+
+	static uint32_t updateHardware(uint32_t crc, const unsigned char* p, size_t size)
+	{
+		uint64_t crc64 = crc;
+		while (size >= 8)
+		{
+			uint64_t value;
+			memcpy(&value, p, 8);
+			crc64 = _mm_crc32_u64(crc64, value);
+			p += 8;
+			size -= 8;
+		}
+		crc = (uint32_t)crc64;
+		while (size-- > 0)
+		{
+			crc = _mm_crc32_u8(crc, *p++);
+		}
+		return crc;
+	}
+#endif
+
+	static uint32_t multiplyMatrix(const uint32_t* matrix, uint32_t vector)
+	{
+		uint32_t sum = 0;
+		while (vector)
+		{
+			if (vector & 1)
+			{
+				sum ^= *matrix;
+			}
+			vector >>= 1;
+			matrix++;
+		}
+		return sum;
+	}
+
+	static void squareMatrix(uint32_t* square, const uint32_t* matrix)
+	{
+		for (int n = 0; n < 32; n++)
+		{
+			square[n] = multiplyMatrix(matrix, matrix[n]);
+		}
+	}
+
+	// the sum of one part of the file, false when the file cannot be read
+	static bool computePart(const std::string& fileName, long long start, long long end, uint32_t& crc)
+	{
+		std::ifstream ifs(fileName, std::ios::in | std::ios::binary);
+		if (!ifs.is_open())
+		{
+			return false;
+		}
+		ifs.seekg(start, std::ios::beg);
+		std::vector<char> buffer(TVPORT_CHECKSUM_BLOCK_SIZE);
+		crc = 0;
+		for (long long pos = start; pos < end;)
+		{
+			std::streamsize size = (std::streamsize)std::min<long long>(buffer.size(), end - pos);
+			if (!ifs.read(buffer.data(), size))
+			{
+				return false;
+			}
+			crc = update(crc, buffer.data(), (size_t)size);
+			pos += size;
+		}
+		return true;
+	}
+
+public:
+	// continues the sum crc (0 for the start) with the data, as crc32 of zlib does
+	static uint32_t update(uint32_t crc, const void* data, size_t size)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		crc = ~crc;
+#ifdef TVPORT_CHECKSUM_SSE42
+		if (hasSse42())
+		{
+			return ~updateHardware(crc, p, size);
+		}
+#endif
+		return ~updateSoftware(crc, p, size);
+	}
+
+	// the sum of two joined blocks from their sums, the second block has length2 bytes
+	static uint32_t combine(uint32_t crc1, uint32_t crc2, long long length2)
+	{
+		if (length2 <= 0)
+		{
+			return crc1;
+		}
+		uint32_t even[32], odd[32];
+		odd[0] = TVPORT_CHECKSUM_POLYNOMIAL;
+		uint32_t row = 1;
+		for (int n = 1; n < 32; n++)
+		{
+			odd[n] = row;
+			row <<= 1;
+		}
+		// the operators for two and four zero bits
+		squareMatrix(even, odd);
+		squareMatrix(odd, even);
+		do {
+			squareMatrix(even, odd);
+			if (length2 & 1)
+			{
+				crc1 = multiplyMatrix(even, crc1);
+			}
+			length2 >>= 1;
+			if (length2 == 0)
+			{
+				break;
+			}
+			squareMatrix(odd, even);
+			if (length2 & 1)
+			{
+				crc1 = multiplyMatrix(odd, crc1);
+			}
+			length2 >>= 1;
+		} while (length2 != 0);
+		return crc1 ^ crc2;
+	}
+
+	// reads the first size bytes of the file once, big files are read in parts by several threads
+	static bool computeFile(const std::string& fileName, long long size, uint32_t& crc)
+	{
+		long long threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::max(1LL, std::min(threads, size / TVPORT_CHECKSUM_MINIMUM_PART));
+		long long partSize = (size + threads - 1) / threads;
+		int n = (int)threads;
+		std::vector<uint32_t> sums(n, 0);
+		std::vector<char> success(n, 0);
+		std::vector<std::thread> workers;
+		for (int i = 1; i < n; i++)
+		{
+			workers.emplace_back([&, i]() {
+				success[i] = computePart(fileName, i * partSize, std::min(size, (i + 1) * partSize), sums[i]);
+			});
+		}
+		success[0] = computePart(fileName, 0, std::min(size, partSize), sums[0]);
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+		crc = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (!success[i])
+			{
+				return false;
+			}
+			crc = combine(crc, sums[i], std::min(size, (i + 1) * partSize) - i * partSize);
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*************************************************************
+TvCompositor owns one canvas of the size of the screen, it is allocated once and shown instead of the frames.
+The content box is the screen without the paddings (padding_left, padding_top, padding_right, padding_bottom),
+every scaled frame is centered in the content box and copied into its part of the canvas,
+a frame bigger than the box is cut to the box.
+Everything around the frame is filled with the background color (background_color.txt, 0xRRGGBB),
+but only when the place of the frame changes, so a video of the same size only copies its pixels
+and the canvas is never cleared as a whole.
+**************************************************************/
+
+#ifndef TVPORT_COMPOSITOR_HPP
+#define TVPORT_COMPOSITOR_HPP
+
+#include "opencv2/core.hpp"
+
+class TvCompositor
+{
+	cv::Mat canvas;
+	cv::Rect contentBox;
+	cv::Rect framePlace;
+	cv::Scalar background;
+	bool borderValid = false;
+
+	void fillArea(cv::Rect area)
+	{
+		area &= cv::Rect(0, 0, canvas.cols, canvas.rows);
+		if (area.area() > 0)
+		{
+			// setTo is vectorized by OpenCV
+			canvas(area).setTo(background);
+		}
+	}
+
+	// fills everything around the place of the frame
+	void fillBorder(cv::Rect place)
+	{
+		int width = canvas.cols, height = canvas.rows;
+		if (place.area() <= 0)
+		{
+			fillArea(cv::Rect(0, 0, width, height));
+			return;
+		}
+		fillArea(cv::Rect(0, 0, width, place.y));
+		fillArea(cv::Rect(0, place.y + place.height, width, height - place.y - place.height));
+		fillArea(cv::Rect(0, place.y, place.x, place.height));
+		fillArea(cv::Rect(place.x + place.width, place.y, width - place.x - place.width, place.height));
+	}
+
+public:
+	static cv::Scalar colorToScalar(int color)
+	{
+		// OpenCV keeps the channels in the BGR order
+		return cv::Scalar(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff);
+	}
+
+	// the canvas is allocated again only when the size of the screen changes
+	void configure(int width, int height, int paddingTop, int paddingRight, int paddingBottom, int paddingLeft, int backgroundColor)
+	{
+		if (width <= 0 || height <= 0)
+		{
+			return;
+		}
+		if (canvas.cols != width || canvas.rows != height)
+		{
+			canvas.create(height, width, CV_8UC3);
+			borderValid = false;
+		}
+		cv::Rect box(paddingLeft, paddingTop, width - paddingLeft - paddingRight, height - paddingTop - paddingBottom);
+		cv::Scalar color = colorToScalar(backgroundColor);
+		if (box != contentBox || color != background)
+		{
+			contentBox = box;
+			background = color;
+			borderValid = false;
+		}
+	}
+
+	bool isConfigured()
+	{
+		return !canvas.empty();
+	}
+
+	cv::Rect getContentBox()
+	{
+		return contentBox;
+	}
+
+	const cv::Mat& compose(const cv::Mat& frame)
+	{
+		cv::Rect place(contentBox.x + (contentBox.width - frame.cols) / 2, contentBox.y + (contentBox.height - frame.rows) / 2, frame.cols, frame.rows);
+		cv::Rect visible = place & contentBox & cv::Rect(0, 0, canvas.cols, canvas.rows);
+		if (!borderValid || visible != framePlace)
+		{
+			fillBorder(visible);
+			framePlace = visible;
+			borderValid = true;
+		}
+		if (visible.area() > 0)
+		{
+			cv::Rect source(visible.x - place.x, visible.y - place.y, visible.width, visible.height);
+			frame(source).copyTo(canvas(visible));
+		}
+		return canvas;
+	}
+};
+
+#endif
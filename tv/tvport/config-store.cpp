@@ -0,0 +1,205 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <boost/json.hpp>
+#include "config-store.hpp"
+
+namespace json = boost::json;
+
+// the names of the parameters in parameters.json
+static const std::pair<const char*, int TvConfig::*> configFields[] = {
+    { "paddingTop", &TvConfig::paddingTop },
+    { "paddingRight", &TvConfig::paddingRight },
+    { "paddingBottom", &TvConfig::paddingBottom },
+    { "paddingLeft", &TvConfig::paddingLeft },
+    { "backgroundColor", &TvConfig::backgroundColor },
+    { "noUpscale", &TvConfig::noUpscale },
+    { "portNumber", &TvConfig::portNumber },
+    { "pictureCacheMb", &TvConfig::pictureCacheMb },
+    { "videoCacheMb", &TvConfig::videoCacheMb },
+    { "rawClipSeconds", &TvConfig::rawClipSeconds },
+    { "rawClipBudgetMb", &TvConfig::rawClipBudgetMb },
+    { "janitorMbPerSecond", &TvConfig::janitorMbPerSecond },
+    { "slotCount", &TvConfig::slotCount },
+    { "httpThreads", &TvConfig::httpThreads },
+    { "httpWorkers", &TvConfig::httpWorkers },
+    { "httpQueueLimit", &TvConfig::httpQueueLimit },
+};
+
+// the former files of ParamUtils, one parameter in each
+static const struct {
+    const char* fileName;
+    int TvConfig::* field;
+    int (*read)();
+} legacyFields[] = {
+    { "padding_top.txt", &TvConfig::paddingTop, &ParamUtils::readParameterPaddingTop },
+    { "padding_right.txt", &TvConfig::paddingRight, &ParamUtils::readParameterPaddingRight },
+    { "padding_bottom.txt", &TvConfig::paddingBottom, &ParamUtils::readParameterPaddingBottom },
+    { "padding_left.txt", &TvConfig::paddingLeft, &ParamUtils::readParameterPaddingLeft },
+    { "background_color.txt", &TvConfig::backgroundColor, &ParamUtils::readParameterBackgroundColor },
+    { "no_upscale.txt", &TvConfig::noUpscale, &ParamUtils::readParameterNoUpscale },
+    { "port_number.txt", &TvConfig::portNumber, &ParamUtils::readParameterPortNumber },
+    { "picture_cache_mb.txt", &TvConfig::pictureCacheMb, &ParamUtils::readParameterPictureCacheMb },
+    { "video_cache_mb.txt", &TvConfig::videoCacheMb, &ParamUtils::readParameterVideoCacheMb },
+    { "raw_clip_seconds.txt", &TvConfig::rawClipSeconds, &ParamUtils::readParameterRawClipSeconds },
+    { "raw_clip_budget_mb.txt", &TvConfig::rawClipBudgetMb, &ParamUtils::readParameterRawClipBudgetMb },
+    { "janitor_mb_per_second.txt", &TvConfig::janitorMbPerSecond, &ParamUtils::readParameterJanitorMbPerSecond },
+    { "slot_count.txt", &TvConfig::slotCount, &ParamUtils::readParameterSlotCount },
+};
+
+TvConfigStore tvConfigStore;
+
+TvConfigStore::TvConfigStore()
+{
+    TvConfig loaded;
+    if (!readFile(TVPORT_CONFIG_FILE, loaded))
+    {
+        loaded = readLegacyFiles();
+        writeFile(TVPORT_CONFIG_FILE, loaded);
+    }
+    config.store(std::make_shared<const TvConfig>(loaded), std::memory_order_release);
+}
+
+TvConfig TvConfigStore::readLegacyFiles()
+{
+    TvConfig result;
+    for (auto const& legacy : legacyFields)
+    {
+        result.*legacy.field = legacy.read();
+    }
+    return result;
+}
+
+// a missing or wrong parameter keeps its default value
+bool TvConfigStore::readFile(const std::string& fileName, TvConfig& result)
+{
+    std::ifstream ifs(fileName);
+    if (!ifs.is_open())
+    {
+        return false;
+    }
+    std::string input(std::istreambuf_iterator<char>(ifs), {});
+    try {
+        json::object o = json::parse(input).as_object();
+        for (auto const& [name, field] : configFields)
+        {
+            const json::value* v = o.if_contains(name);
+            if (v != nullptr && v->is_int64())
+            {
+                result.*field = (int)v->as_int64();
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "File " << fileName << " cannot be read: " << e.what() << std::endl;
+        return false;
+    }
+    if (result.slotCount < 2)
+    {
+        result.slotCount = 2;
+    }
+    if (result.slotCount > TVPORT_MAXIMUM_SLOT_NUMBER)
+    {
+        result.slotCount = TVPORT_MAXIMUM_SLOT_NUMBER;
+    }
+    for (int TvConfig::* field : { &TvConfig::httpThreads, &TvConfig::httpWorkers, &TvConfig::httpQueueLimit })
+    {
+        if (result.*field < 1)
+        {
+            result.*field = 1;
+        }
+    }
+    return true;
+}
+
+// written to a temporary file first, the rename replaces the former file at once
+bool TvConfigStore::writeFile(const std::string& fileName, const TvConfig& value)
+{
+    json::object o;
+    for (auto const& [name, field] : configFields)
+    {
+        o[name] = value.*field;
+    }
+    std::string tempName = fileName + ".tmp";
+    {
+        std::ofstream ofs(tempName, std::ios::out | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            std::cout << "Cannot write to " << tempName << std::endl;
+            return false;
+        }
+        ofs << json::serialize(o) << std::endl;
+        if (ofs.fail())
+        {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempName, fileName, ec);
+    if (ec)
+    {
+        std::cout << "Cannot replace " << fileName << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TvConfigStore::update(const std::function<void(TvConfig&)>& change)
+{
+    std::lock_guard<std::mutex> lock(updateMutex);
+    TvConfig changed = *get();
+    change(changed);
+    bool written = writeFile(TVPORT_CONFIG_FILE, changed);
+    publish(changed);
+    return written;
+}
+
+void TvConfigStore::publish(const TvConfig& value)
+{
+    std::shared_ptr<const TvConfig> former = get();
+    if (*former == value)
+    {
+        return;
+    }
+    if (former->portNumber != value.portNumber)
+    {
+        std::cout << "Port number " << value.portNumber << " is used after the restart" << std::endl;
+    }
+    config.store(std::make_shared<const TvConfig>(value), std::memory_order_release);
+}
+
+bool TvConfigStore::reload()
+{
+    std::lock_guard<std::mutex> lock(updateMutex);
+    TvConfig loaded = *get();
+    if (!readFile(TVPORT_CONFIG_FILE, loaded))
+    {
+        return false;
+    }
+    publish(loaded);
+    return true;
+}
+
+bool TvConfigStore::reloadLegacyFile(const std::string& fileName)
+{
+    for (auto const& legacy : legacyFields)
+    {
+        if (fileName != legacy.fileName)
+        {
+            continue;
+        }
+        int value = legacy.read();
+        std::lock_guard<std::mutex> lock(updateMutex);
+        TvConfig changed = *get();
+        changed.*legacy.field = value;
+        if (changed != *get())
+        {
+            writeFile(TVPORT_CONFIG_FILE, changed);
+            publish(changed);
+        }
+        return true;
+    }
+    return false;
+}
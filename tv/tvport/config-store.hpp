@@ -0,0 +1,93 @@
+/*************************************************************
+TvConfigStore keeps the parameters of the tvport in memory, they are read from parameters.json once at the start.
+The parameters are an immutable TvConfig published by an atomic shared pointer, so the render thread,
+the prefetch thread and the http server read them without locks and without touching the file system.
+update copies the parameters, changes the copy, writes it to parameters.json.tmp and renames it over parameters.json,
+and then publishes it, so a reader sees either all of the changes or none, and a power cut leaves one of the two files.
+When parameters.json does not exist, the parameters are taken from the former files of ParamUtils (padding_top.txt, ...).
+The hot reload (hot-reload.hpp) calls reload when parameters.json is changed from outside,
+and reloadLegacyFile when one of the former files is written, so the tools which write them still work.
+slot.txt and playlist_id.txt are not parameters but the state of the slots, they stay with ParamUtils.
+**************************************************************/
+
+#ifndef TVPORT_CONFIG_STORE_HPP
+#define TVPORT_CONFIG_STORE_HPP
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "parameters.hpp"
+
+#define TVPORT_CONFIG_FILE "parameters.json"
+
+struct TvConfig {
+	int paddingTop = 0;
+	int paddingRight = 0;
+	int paddingBottom = 0;
+	int paddingLeft = 0;
+	// 0xRRGGBB
+	int backgroundColor = 0;
+	// 1 means small pictures and videos are not extended to the screen
+	int noUpscale = 0;
+	int portNumber = TVPORT_DEFAULT_PORT_NUMBER;
+	int pictureCacheMb = TVPORT_DEFAULT_PICTURE_CACHE_MB;
+	int videoCacheMb = TVPORT_DEFAULT_VIDEO_CACHE_MB;
+	// 0 means no raw clips are made
+	int rawClipSeconds = TVPORT_DEFAULT_RAW_CLIP_SECONDS;
+	int rawClipBudgetMb = TVPORT_DEFAULT_RAW_CLIP_BUDGET_MB;
+	// 0 means no limit
+	int janitorMbPerSecond = TVPORT_DEFAULT_JANITOR_MB_PER_SECOND;
+	// the slots from TVPORT_MINIMUM_SLOT_NUMBER to this one are used
+	int slotCount = TVPORT_DEFAULT_SLOT_COUNT;
+	// taken at the start of the http server
+	int httpThreads = TVPORT_DEFAULT_HTTP_THREADS;
+	int httpWorkers = TVPORT_DEFAULT_HTTP_WORKERS;
+	int httpQueueLimit = TVPORT_DEFAULT_HTTP_QUEUE;
+
+	bool operator==(const TvConfig&) const = default;
+
+	// the paddings as /info shows them: top,right,bottom,left
+	std::string getAllPaddings() const
+	{
+		return std::to_string(paddingTop) + "," + std::to_string(paddingRight) + "," + std::to_string(paddingBottom) + "," + std::to_string(paddingLeft);
+	}
+};
+
+class TvConfigStore
+{
+	std::atomic<std::shared_ptr<const TvConfig>> config;
+	// one update at a time, so no change of a concurrent update is lost
+	std::mutex updateMutex;
+
+	static TvConfig readLegacyFiles();
+	static bool readFile(const std::string& fileName, TvConfig& result);
+	static bool writeFile(const std::string& fileName, const TvConfig& value);
+	// called under updateMutex
+	void publish(const TvConfig& value);
+
+public:
+	TvConfigStore();
+
+	// the parameters do not change while the pointer is held
+	std::shared_ptr<const TvConfig> get() const
+	{
+		return config.load(std::memory_order_acquire);
+	}
+
+	// false when the parameters cannot be written, they are published in memory anyway
+	bool update(const std::function<void(TvConfig&)>& change);
+
+	// parameters.json is read again, a parameter missing in it keeps its value, false when it cannot be read
+	bool reload();
+
+	// the parameter of the former file is taken into the store, false when the name is not such a file
+	bool reloadLegacyFile(const std::string& fileName);
+};
+
+extern TvConfigStore tvConfigStore;
+
+#endif
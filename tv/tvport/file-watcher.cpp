@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include "file-watcher.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
+
+// one overlapped ReadDirectoryChangesW per directory, the events are waited for together with the stop event
+class TvWindowsWatchBackend : public TvWatchBackend
+{
+    struct Directory {
+        std::string name;
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped = {};
+        // ReadDirectoryChangesW needs a DWORD aligned buffer
+        DWORD buffer[4096];
+    };
+
+    std::vector<std::unique_ptr<Directory>> directories;
+    HANDLE stopEvent;
+
+    static bool read(Directory& directory)
+    {
+        return ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, &directory.overlapped, NULL) != 0;
+    }
+
+public:
+    TvWindowsWatchBackend()
+    {
+        stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    ~TvWindowsWatchBackend()
+    {
+        for (auto& directory : directories)
+        {
+            CancelIo(directory->handle);
+            CloseHandle(directory->handle);
+            CloseHandle(directory->overlapped.hEvent);
+        }
+        CloseHandle(stopEvent);
+    }
+
+    bool add(const std::string& name) override
+    {
+        // the stop event takes one of the MAXIMUM_WAIT_OBJECTS
+        if (directories.size() + 1 >= MAXIMUM_WAIT_OBJECTS)
+        {
+            return false;
+        }
+        auto directory = std::make_unique<Directory>();
+        directory->name = name;
+        directory->handle = CreateFileA(name.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+        if (directory->handle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        directory->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (!read(*directory))
+        {
+            CloseHandle(directory->handle);
+            CloseHandle(directory->overlapped.hEvent);
+            return false;
+        }
+        directories.push_back(std::move(directory));
+        return true;
+    }
+
+    bool wait(int timeout, std::vector<TvWatchedFile>& changed) override
+    {
+        std::vector<HANDLE> events;
+        events.push_back(stopEvent);
+        for (auto& directory : directories)
+        {
+            events.push_back(directory->overlapped.hEvent);
+        }
+        DWORD result = WaitForMultipleObjects((DWORD)events.size(), events.data(), FALSE, timeout < 0 ? INFINITE : (DWORD)timeout);
+        if (result == WAIT_OBJECT_0 || result == WAIT_FAILED)
+        {
+            return false;
+        }
+        if (result == WAIT_TIMEOUT)
+        {
+            return true;
+        }
+        Directory& directory = *directories.at(result - WAIT_OBJECT_0 - 1);
+        DWORD size = 0;
+        ResetEvent(directory.overlapped.hEvent);
+        if (!GetOverlappedResult(directory.handle, &directory.overlapped, &size, FALSE) || size == 0)
+        {
+            // the buffer has overflowed
+            changed.push_back(TvWatchedFile(directory.name, "*"));
+        }
+        else
+        {
+            const char* p = (const char*)directory.buffer;
+            while (true)
+            {
+                const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)p;
+                int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), NULL, 0, NULL, NULL);
+                std::string name(length, '\0');
+                WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), name.data(), length, NULL, NULL);
+                changed.push_back(TvWatchedFile(directory.name, name));
+                if (info->NextEntryOffset == 0)
+                {
+                    break;
+                }
+                p += info->NextEntryOffset;
+            }
+        }
+        read(directory);
+        return true;
+    }
+
+    void interrupt() override
+    {
+        SetEvent(stopEvent);
+    }
+};
+
+std::unique_ptr<TvWatchBackend> TvWatchBackend::create()
+{
+    return std::make_unique<TvWindowsWatchBackend>();
+}
+
+#else
+
+// one inotify descriptor for all directories, a pipe wakes the waiting poll for the stop
+class TvInotifyBackend : public TvWatchBackend
+{
+    int inotifyFd;
+    int stopPipe[2] = { -1, -1 };
+    std::map<int, std::string> directories;
+
+public:
+    TvInotifyBackend()
+    {
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (pipe(stopPipe) != 0)
+        {
+            stopPipe[0] = stopPipe[1] = -1;
+        }
+    }
+
+    ~TvInotifyBackend()
+    {
+        for (int fd : { inotifyFd, stopPipe[0], stopPipe[1] })
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    bool add(const std::string& name) override
+    {
+        // the files are reported when they are closed after writing or renamed into place
+        int wd = inotifyFd < 0 ? -1 : inotify_add_watch(inotifyFd, name.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE);
+        if (wd < 0)
+        {
+            return false;
+        }
+        directories[wd] = name;
+        return true;
+    }
+
+    bool wait(int timeout, std::vector<TvWatchedFile>& changed) override
+    {
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+        int n = poll(fds, 2, timeout);
+        if (n < 0)
+        {
+            return errno == EINTR;
+        }
+        if (fds[1].revents != 0)
+        {
+            return false;
+        }
+        alignas(inotify_event) char buffer[16384];
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* p = buffer; p < buffer + length;)
+            {
+                const inotify_event* event = (const inotify_event*)p;
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    for (auto const& [wd, name] : directories)
+                    {
+                        changed.push_back(TvWatchedFile(name, "*"));
+                    }
+                }
+                else if (event->len > 0 && directories.count(event->wd) > 0)
+                {
+                    changed.push_back(TvWatchedFile(directories.at(event->wd), event->name));
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return true;
+    }
+
+    void interrupt() override
+    {
+        char c = 0;
+        if (write(stopPipe[1], &c, 1) != 1)
+        {
+            std::cout << "File watcher cannot be stopped" << std::endl;
+        }
+    }
+};
+
+std::unique_ptr<TvWatchBackend> TvWatchBackend::create()
+{
+    return std::make_unique<TvInotifyBackend>();
+}
+
+#endif
+
+bool TvFileWatcher::start(const std::vector<std::string>& directories, std::function<void(const std::string& directory, const std::string& name)> callback)
+{
+    backend = TvWatchBackend::create();
+    onChange = callback;
+    bool watching = false;
+    for (const std::string& directory : directories)
+    {
+        if (backend->add(directory))
+        {
+            watching = true;
+            watchedDirectories.push_back(directory);
+        }
+        else
+        {
+            std::cout << "Directory " << directory << " cannot be watched" << std::endl;
+        }
+    }
+    if (watching)
+    {
+        worker = std::thread(&TvFileWatcher::run, this);
+    }
+    return watching;
+}
+
+void TvFileWatcher::run()
+{
+    // the files which have changed, by the time they are reported
+    std::map<TvWatchedFile, std::chrono::steady_clock::time_point> pending;
+    std::vector<TvWatchedFile> changed;
+    while (!stopping)
+    {
+        int timeout = -1;
+        auto now = std::chrono::steady_clock::now();
+        for (auto const& [file, due] : pending)
+        {
+            int left = (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count());
+            timeout = timeout < 0 ? left : std::min(timeout, left);
+        }
+        changed.clear();
+        if (!backend->wait(timeout, changed))
+        {
+            break;
+        }
+        now = std::chrono::steady_clock::now();
+        for (const TvWatchedFile& file : changed)
+        {
+            pending[file] = now + std::chrono::milliseconds(TVPORT_WATCH_DEBOUNCE_MS);
+        }
+        for (auto it = pending.begin(); it != pending.end() && !stopping;)
+        {
+            if (it->second > now)
+            {
+                it++;
+                continue;
+            }
+            try {
+                onChange(it->first.first, it->first.second);
+            }
+            catch (const std::exception& e)
+            {
+                std::cout << "Change of " << it->first.first << "/" << it->first.second << " cannot be taken: " << e.what() << std::endl;
+            }
+            it = pending.erase(it);
+        }
+    }
+}
+
+TvFileWatcher::~TvFileWatcher()
+{
+    stopping = true;
+    if (worker.joinable())
+    {
+        backend->interrupt();
+        worker.join();
+    }
+}
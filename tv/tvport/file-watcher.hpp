@@ -0,0 +1,59 @@
+/*************************************************************
+TvFileWatcher tells which files of the watched directories have changed, so nothing polls the disk for them.
+The changes come from the operating system by TvWatchBackend: inotify on Linux, ReadDirectoryChangesW on Windows.
+A file is reported once, after it has not changed for TVPORT_WATCH_DEBOUNCE_MS, so a file written in several steps
+is read only when it is complete. When the operating system has lost changes, the name is "*": everything may have changed.
+The callback runs on the thread of the watcher.
+**************************************************************/
+
+#ifndef TVPORT_FILE_WATCHER_HPP
+#define TVPORT_FILE_WATCHER_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define TVPORT_WATCH_DEBOUNCE_MS 300
+
+// directory and file name
+typedef std::pair<std::string, std::string> TvWatchedFile;
+
+class TvWatchBackend
+{
+public:
+	virtual ~TvWatchBackend() {}
+	virtual bool add(const std::string& directory) = 0;
+	// waits at most timeout ms (-1 without limit) for changes, false when interrupted
+	virtual bool wait(int timeout, std::vector<TvWatchedFile>& changed) = 0;
+	// wait returns false, it may be called from any thread
+	virtual void interrupt() = 0;
+	// the backend of this operating system
+	static std::unique_ptr<TvWatchBackend> create();
+};
+
+class TvFileWatcher
+{
+	std::unique_ptr<TvWatchBackend> backend;
+	std::function<void(const std::string& directory, const std::string& name)> onChange;
+	std::thread worker;
+	std::atomic<bool> stopping{ false };
+	// the directories taken by the backend, the changes of the others are not reported
+	std::vector<std::string> watchedDirectories;
+
+	void run();
+
+public:
+	// false when no directory can be watched
+	bool start(const std::vector<std::string>& directories, std::function<void(const std::string& directory, const std::string& name)> callback);
+	const std::vector<std::string>& getWatchedDirectories()
+	{
+		return watchedDirectories;
+	}
+	~TvFileWatcher();
+};
+
+#endif
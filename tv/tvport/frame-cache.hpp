@@ -0,0 +1,220 @@
+/*************************************************************
+TvFrameCache keeps the pictures of the current slot already decoded and scaled to the screen,
+so every pass through the playlist does not call imread and resize for the same files again.
+
+The key is the slot file name (it already contains the check sum and the length of the file)
+plus the screen geometry (desktop resolution and paddings), so a changed file or a changed
+padding never hits an old entry.
+Every entry belongs to a slot, and the entries of other slots are dropped when the slot is switched.
+The total size of the cached frames is limited by the memory budget (picture_cache_mb.txt),
+the least recently shown pictures are evicted first.
+The cache is shared by the render thread and the prefetch thread, so every call is guarded by a mutex.
+
+TvVideoFrameCache does the same for the short videos: all frames of the video decoded and scaled
+during the first play are kept in memory (video_cache_mb.txt), so the next loops only present them.
+The budget is shared by all videos of the current slot, the least recently played video is evicted first.
+Every entry belongs to the slot generation of TvPortSlots, so the cache is emptied
+as soon as switchToCurrentTask replaces the current slot.
+**************************************************************/
+
+#ifndef TVPORT_FRAME_CACHE_HPP
+#define TVPORT_FRAME_CACHE_HPP
+
+#include "opencv2/core.hpp"
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TvFrameCache
+{
+	struct Entry {
+		cv::Mat frame;
+		int slotNumber;
+		std::string geometry;
+		size_t bytes;
+		std::list<std::string>::iterator lru;
+	};
+	std::map<std::string, Entry> entries;
+	std::list<std::string> lruOrder;
+	size_t budget;
+	size_t used = 0;
+	std::mutex cacheMutex;
+
+	void removeEntry(std::map<std::string, Entry>::iterator it)
+	{
+		used -= it->second.bytes;
+		lruOrder.erase(it->second.lru);
+		entries.erase(it);
+	}
+
+public:
+	TvFrameCache(size_t budgetBytes)
+	{
+		budget = budgetBytes;
+	}
+
+	static std::string makeKey(const std::string& fileName, const std::string& geometry)
+	{
+		return fileName + "@" + geometry;
+	}
+
+	bool find(const std::string& fileName, const std::string& geometry, cv::Mat& frame)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto it = entries.find(makeKey(fileName, geometry));
+		if (it == entries.end())
+		{
+			return false;
+		}
+		lruOrder.splice(lruOrder.begin(), lruOrder, it->second.lru);
+		frame = it->second.frame;
+		return true;
+	}
+
+	bool insert(const std::string& fileName, const std::string& geometry, int slotNumber, const cv::Mat& frame)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		size_t bytes = frame.total() * frame.elemSize();
+		if (frame.empty() || bytes > budget)
+		{
+			return false;
+		}
+		std::string key = makeKey(fileName, geometry);
+		auto it = entries.find(key);
+		if (it != entries.end())
+		{
+			removeEntry(it);
+		}
+		while (used + bytes > budget && !lruOrder.empty())
+		{
+			removeEntry(entries.find(lruOrder.back()));
+		}
+		lruOrder.push_front(key);
+		entries[key] = { frame, slotNumber, geometry, bytes, lruOrder.begin() };
+		used += bytes;
+		return true;
+	}
+
+	// drops all entries which belong to other slots or were scaled for another geometry
+	void retain(int slotNumber, const std::string& geometry)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			auto current = it++;
+			if (current->second.slotNumber != slotNumber || current->second.geometry != geometry)
+			{
+				removeEntry(current);
+			}
+		}
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		entries.clear();
+		lruOrder.clear();
+		used = 0;
+	}
+
+	bool isFull()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return used >= budget;
+	}
+
+	size_t getUsedBytes()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return used;
+	}
+};
+
+struct TvDecodedVideo {
+	std::vector<cv::Mat> frames;
+	// in ms, presentation time of every frame
+	std::vector<double> timestamps;
+	double fps = 0;
+	size_t bytes = 0;
+};
+
+class TvVideoFrameCache
+{
+	struct Entry {
+		std::shared_ptr<TvDecodedVideo> video;
+		std::list<std::string>::iterator lru;
+	};
+	std::map<std::string, Entry> entries;
+	std::list<std::string> lruOrder;
+	size_t budget;
+	size_t used = 0;
+	int generation = -1;
+	std::mutex cacheMutex;
+
+	void checkGeneration(int slotGeneration)
+	{
+		if (slotGeneration != generation)
+		{
+			entries.clear();
+			lruOrder.clear();
+			used = 0;
+			generation = slotGeneration;
+		}
+	}
+
+public:
+	TvVideoFrameCache(size_t budgetBytes)
+	{
+		budget = budgetBytes;
+	}
+
+	size_t getBudget()
+	{
+		return budget;
+	}
+
+	std::shared_ptr<TvDecodedVideo> find(const std::string& fileName, const std::string& geometry, int slotGeneration)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		checkGeneration(slotGeneration);
+		auto it = entries.find(TvFrameCache::makeKey(fileName, geometry));
+		if (it == entries.end())
+		{
+			return nullptr;
+		}
+		lruOrder.splice(lruOrder.begin(), lruOrder, it->second.lru);
+		return it->second.video;
+	}
+
+	// the played video keeps its frames even if it is evicted meanwhile, they are shared
+	bool insert(const std::string& fileName, const std::string& geometry, int slotGeneration, std::shared_ptr<TvDecodedVideo> video)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		checkGeneration(slotGeneration);
+		if (video->frames.empty() || video->bytes > budget)
+		{
+			return false;
+		}
+		std::string key = TvFrameCache::makeKey(fileName, geometry);
+		if (entries.find(key) != entries.end())
+		{
+			return false;
+		}
+		while (used + video->bytes > budget && !lruOrder.empty())
+		{
+			auto it = entries.find(lruOrder.back());
+			used -= it->second.video->bytes;
+			entries.erase(it);
+			lruOrder.pop_back();
+		}
+		lruOrder.push_front(key);
+		entries[key] = { video, lruOrder.begin() };
+		used += video->bytes;
+		return true;
+	}
+};
+
+#endif
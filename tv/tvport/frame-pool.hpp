@@ -0,0 +1,90 @@
+/*************************************************************
+TvFramePool keeps the frame buffers of the render path for reuse, so decoding, resizing and presenting
+do not allocate a new cv::Mat for every frame.
+The buffers are kept by size and type. A buffer is free when the pool holds the only reference to it:
+whoever took it with acquire simply drops its cv::Mat when it is done, and the buffer comes back by itself.
+The hits and misses show how well the buffers are reused, after the first frames of a video
+every acquire must be a hit.
+The pool grows to the number of buffers used at the same time, trim releases the free ones
+when the sizes are not needed any more (on slot switch).
+**************************************************************/
+
+#ifndef TVPORT_FRAME_POOL_HPP
+#define TVPORT_FRAME_POOL_HPP
+
+#include "opencv2/core.hpp"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class TvFramePool
+{
+	std::map<std::tuple<int, int, int>, std::vector<cv::Mat>> buffers;
+	std::mutex poolMutex;
+	std::atomic<long> hits{ 0 }, misses{ 0 };
+
+	static bool isFree(const cv::Mat& buffer)
+	{
+		return buffer.u != nullptr && buffer.u->refcount == 1;
+	}
+
+public:
+	cv::Mat acquire(cv::Size size, int type)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		std::vector<cv::Mat>& list = buffers[std::make_tuple(size.width, size.height, type)];
+		for (cv::Mat& buffer : list)
+		{
+			if (isFree(buffer))
+			{
+				hits++;
+				return buffer;
+			}
+		}
+		misses++;
+		cv::Mat buffer(size, type);
+		list.push_back(buffer);
+		return buffer;
+	}
+
+	// makes sure the buffer has the required size and type, taking it from the pool when it does not
+	void prepare(cv::Mat& buffer, cv::Size size, int type)
+	{
+		if (buffer.size() != size || buffer.type() != type)
+		{
+			buffer = acquire(size, type);
+		}
+	}
+
+	void trim()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		for (auto it = buffers.begin(); it != buffers.end();)
+		{
+			std::vector<cv::Mat>& list = it->second;
+			list.erase(std::remove_if(list.begin(), list.end(), isFree), list.end());
+			it = list.empty() ? buffers.erase(it) : std::next(it);
+		}
+	}
+
+	long getHits()
+	{
+		return hits.load();
+	}
+
+	long getMisses()
+	{
+		return misses.load();
+	}
+
+	std::string getStatistics()
+	{
+		return "frame pool hits=" + std::to_string(getHits()) + " misses=" + std::to_string(getMisses());
+	}
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*************************************************************
+TvFrameRing is a bounded single-producer/single-consumer ring of preallocated frames.
+The decode thread of the video is the only producer, the render thread is the only consumer,
+so the ring needs no mutex: each side owns its own index and publishes it with an atomic store.
+
+The producer asks for the free frame with waitWriteFrame, which blocks while the ring is full until the consumer pops a frame, fills it (resize writes into the existing buffer,
+so nothing is allocated when the size does not change) and publishes it with push.
+Every frame carries its presentation timestamp, so the consumer can show it at its due time.
+The consumer takes the oldest ready frame with getReadFrame, shows it and gives it back with pop.
+The same buffers go round the ring all the time, so steady playback makes no allocations.
+**************************************************************/
+
+#ifndef TVPORT_FRAME_RING_HPP
+#define TVPORT_FRAME_RING_HPP
+
+#include "opencv2/core.hpp"
+#include <atomic>
+#include <vector>
+
+// number of frames decoded ahead of the presented one
+#define TVPORT_FRAME_RING_SIZE 4
+
+struct TvRingFrame {
+	cv::Mat image;
+	// presentation time of the frame in ms from the start of the video
+	double timestamp = 0;
+};
+
+class TvFrameRing
+{
+	std::vector<TvRingFrame> frames;
+	size_t capacity;
+	// written only by the producer
+	std::atomic<size_t> head{ 0 };
+	// written only by the consumer
+	std::atomic<size_t> tail{ 0 };
+	std::atomic<bool> finished{ false };
+	std::atomic<bool> stopped{ false };
+	// changed by every pop and by stop, the waiting producer is woken by it
+	std::atomic<unsigned> freed{ 0 };
+
+public:
+	TvFrameRing(size_t size = TVPORT_FRAME_RING_SIZE)
+	{
+		capacity = size;
+		frames.resize(size);
+	}
+
+	// producer side: returns the frame to fill or nullptr when the ring is full
+	TvRingFrame* getWriteFrame()
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= capacity)
+		{
+			return nullptr;
+		}
+		return &frames[h % capacity];
+	}
+
+	// producer side: waits until a frame is free, nullptr when the consumer has stopped the ring
+	TvRingFrame* waitWriteFrame()
+	{
+		while (true)
+		{
+			unsigned signal = freed.load(std::memory_order_acquire);
+			if (stopped.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+			TvRingFrame* frame = getWriteFrame();
+			if (frame != nullptr)
+			{
+				return frame;
+			}
+			freed.wait(signal, std::memory_order_acquire);
+		}
+	}
+
+	void push()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// the producer calls it when there will be no more frames
+	void finish()
+	{
+		finished.store(true, std::memory_order_release);
+	}
+
+	// consumer side: returns the oldest ready frame or nullptr when the ring is empty
+	TvRingFrame* getReadFrame()
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (head.load(std::memory_order_acquire) == t)
+		{
+			return nullptr;
+		}
+		return &frames[t % capacity];
+	}
+
+	void pop()
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		freed.fetch_add(1, std::memory_order_release);
+		freed.notify_one();
+	}
+
+	// the consumer calls it when it takes no more frames, the waiting producer returns
+	void stop()
+	{
+		stopped.store(true, std::memory_order_release);
+		freed.fetch_add(1, std::memory_order_release);
+		freed.notify_one();
+	}
+
+	// true when the producer finished and all its frames were taken
+	bool isDrained()
+	{
+		return finished.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+	}
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include <iostream>
+#include "hot-reload.hpp"
+#include "config-store.hpp"
+#include "slots.hpp"
+#include "static-files.hpp"
+
+TvHotReload tvHotReload;
+
+void TvHotReload::start()
+{
+    // 0 is the web root, it is watched only for the http server
+    std::vector<std::string> directories = { ".", "0" };
+    int slotCount = tvConfigStore.get()->slotCount;
+    for (int slot = TVPORT_MINIMUM_SLOT_NUMBER; slot <= slotCount; slot++)
+    {
+        directories.push_back(std::to_string(slot));
+    }
+    if (watcher.start(directories, &TvHotReload::onChange))
+    {
+        tvStaticFiles.watch(watcher.getWatchedDirectories());
+    }
+}
+
+void TvHotReload::onChange(const std::string& directory, const std::string& name)
+{
+    bool all = name == "*";
+    tvStaticFiles.forget(directory, name);
+    if (directory == ".")
+    {
+        if (all || name == TVPORT_CONFIG_FILE)
+        {
+            tvConfigStore.reload();
+        }
+        if (all || name == ParamUtils::getParameterSlotFileName())
+        {
+            tvPortSlots.reloadSlotParameter();
+        }
+        if (!all)
+        {
+            tvConfigStore.reloadLegacyFile(name);
+        }
+        return;
+    }
+    if (directory != "0" && (all || name == "config.json"))
+    {
+        tvPortSlots.reloadSlotConfig(ParamUtils::readIntegerFromBuffer((char*)directory.c_str()));
+    }
+}
@@ -0,0 +1,32 @@
+/*************************************************************
+TvHotReload takes the files changed from outside while the tvport runs, the file watcher (file-watcher.hpp) reports them:
+  parameters.json and the former parameter files (padding_top.txt, ...)  the config store publishes new parameters,
+                                                                         the screen takes them before its next item
+  slot.txt                                                               the slot written there is shown, when it is staged
+  <slot>/config.json                                                     the slot is read again (TvPortSlots::reloadSlotConfig)
+  any file of 0/ and of the slot folders                                 the http server forgets its size and time of change
+                                                                         (TvStaticFiles::forget)
+Only the changed file is read, and no file is read while nothing changes.
+**************************************************************/
+
+#ifndef TVPORT_HOT_RELOAD_HPP
+#define TVPORT_HOT_RELOAD_HPP
+
+#include <string>
+
+#include "file-watcher.hpp"
+
+class TvHotReload
+{
+	TvFileWatcher watcher;
+
+	static void onChange(const std::string& directory, const std::string& name);
+
+public:
+	// called after the slots are loaded, the folders of the slots exist then
+	void start();
+};
+
+extern TvHotReload tvHotReload;
+
+#endif
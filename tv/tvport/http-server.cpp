@@ -1,15 +1,21 @@
 #include "webserver/client_http.hpp"
 #include "webserver/server_http.hpp"
 #include "parameters.hpp"
+#include "config-store.hpp"
 #include "slots.hpp"
+#include "buffer-pool.hpp"
+#include "http-worker-pool.hpp"
+#include "static-files.hpp"
 
 #define BOOST_SPIRIT_THREADSAFE
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include <algorithm>
+#include <deque>
 #include <boost/filesystem.hpp>
 #include <fstream>
+#include <regex>
 #include <vector>
 #ifdef HAVE_OPENSSL
 #include "webserver/crypto.hpp"
@@ -21,13 +27,163 @@ using namespace boost::property_tree;
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 
+// the uploads are read from the network piece by piece into these buffers and written to the file at once,
+// so a chunk of any size needs only one buffer of memory
+#define TVPORT_UPLOAD_BUFFER_SIZE (1 << 20)
+#define TVPORT_UPLOAD_FREE_BUFFERS 8
+// the pieces of one upload which are read but not written yet
+#define TVPORT_UPLOAD_QUEUED_PIECES 4
+
+static TvBufferPool uploadBufferPool(TVPORT_UPLOAD_BUFFER_SIZE, TVPORT_UPLOAD_FREE_BUFFERS);
+
+static TvHttpWorkerPool httpWorkerPool;
+
+TvStaticFiles tvStaticFiles;
+
+typedef std::function<void(std::shared_ptr<HttpServer::Response>&, SimpleWeb::CaseInsensitiveMultimap&)> TvWorkerHandler;
+
+// the server sends a response when its last reference is dropped, it is dropped on an io thread and not on a worker
+static void releaseOnIoThread(const std::shared_ptr<boost::asio::io_service>& io, std::shared_ptr<HttpServer::Response>&& response) {
+  boost::asio::post(*io, [response = std::move(response)]() {});
+}
+
+// the handler runs on a worker, the header it gets has the queueing delay in X-Queue-Delay-Ms
+static void runOnWorker(HttpServer& server, std::shared_ptr<HttpServer::Response> response, TvWorkerHandler handler) {
+  std::shared_ptr<boost::asio::io_service> io = server.io_service;
+  bool queued = httpWorkerPool.submit([io, response, handler](double delay) mutable {
+      SimpleWeb::CaseInsensitiveMultimap header;
+      std::stringstream stream;
+      stream << delay;
+      header.emplace("X-Queue-Delay-Ms", stream.str());
+      try {
+          handler(response, header);
+      }
+      catch (const std::exception& e) {
+          response->write(SimpleWeb::StatusCode::server_error_internal_server_error, e.what(), header);
+      }
+      releaseOnIoThread(io, std::move(response));
+      });
+  if (!queued) {
+      SimpleWeb::CaseInsensitiveMultimap header;
+      header.emplace("Retry-After", "1");
+      response->write(SimpleWeb::StatusCode::server_error_service_unavailable, "The server is busy, try again later", header);
+  }
+}
+
+// the pieces of an upload are written to the file by a worker, at most TVPORT_UPLOAD_QUEUED_PIECES of them wait in memory,
+// when they are all taken the server stops reading the socket until the worker has written one of them.
+// The upload is started on the worker as well, it may wait for the locks of the slots, the io threads never wait for the disk
+class TvUploadSink : public SimpleWeb::ContentSink, public std::enable_shared_from_this<TvUploadSink> {
+  std::mutex sinkMutex;
+  std::shared_ptr<char> piece = uploadBufferPool.acquire();
+  // the pieces read from the socket, waiting for the worker
+  std::deque<std::pair<std::shared_ptr<char>, std::size_t>> pieces;
+  // a job of the worker pool writes the pieces, only one at a time for an upload
+  bool writing = false;
+  bool refused = false;
+  std::function<void()> resume;
+  std::function<void()> done;
+  std::string nrUpload;
+  long long amount = 0;
+
+  // called under sinkMutex, the upload is refused when no worker can be got
+  void scheduleWriting() {
+    if (writing || refused) {
+      return;
+    }
+    writing = httpWorkerPool.submit([self = shared_from_this()](double) { self->writePieces(); });
+    if (!writing) {
+      refused = true;
+      pieces.clear();
+    }
+  }
+
+  void writePieces() {
+    if (reply.empty() && upload.slot == nullptr) {
+      reply = tvPortSlots.startUpload(nrUpload, amount, upload);
+    }
+    std::unique_lock<std::mutex> lock(sinkMutex);
+    while (!pieces.empty()) {
+      std::pair<std::shared_ptr<char>, std::size_t> next = std::move(pieces.front());
+      pieces.pop_front();
+      std::function<void()> resumed;
+      std::swap(resumed, resume);
+      lock.unlock();
+      if (resumed) {
+        resumed();
+      }
+      upload.write(next.first.get(), next.second);
+      lock.lock();
+    }
+    writing = false;
+    std::function<void()> finished;
+    std::swap(finished, done);
+    lock.unlock();
+    if (finished) {
+      finished();
+    }
+  }
+
+public:
+  // written only by the worker of the sink, read after finish is done
+  TvPortUpload upload;
+  // the reply, when the upload was refused before its content came
+  std::string reply;
+
+  // the upload is started on a worker while its content is read
+  void start(const std::string& nr, long long size) {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    nrUpload = nr;
+    amount = size;
+    scheduleWriting();
+  }
+
+  // no worker could be got for the pieces, the chunk is answered with 503
+  bool isRefused() {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    return refused;
+  }
+
+  std::pair<char *, std::size_t> buffer() override {
+    return std::make_pair(piece.get(), uploadBufferPool.getBufferSize());
+  }
+
+  bool write(std::size_t size, std::function<void()> resumeReading) override {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    if (refused) {
+      // the rest of the content is read into nothing
+      return true;
+    }
+    pieces.emplace_back(std::move(piece), size);
+    piece = uploadBufferPool.acquire();
+    scheduleWriting();
+    if (refused || pieces.size() < TVPORT_UPLOAD_QUEUED_PIECES) {
+      return true;
+    }
+    resume = std::move(resumeReading);
+    return false;
+  }
+
+  void finish(std::function<void()> whenDone) override {
+    std::unique_lock<std::mutex> lock(sinkMutex);
+    if (writing) {
+      done = std::move(whenDone);
+      return;
+    }
+    lock.unlock();
+    whenDone();
+  }
+};
+
 
 void HttpServerInstance::run() {
-  // HTTP-server at port 80 using 1 thread
-  // Unless you do more heavy non-threaded processing in the resources,
-  // 1 thread is usually faster than several threads
+  // the io threads only read and write the sockets, the handlers touching the disk run on httpWorkerPool,
+  // so /status and /info are answered during big uploads
+  std::shared_ptr<const TvConfig> config = tvConfigStore.get();
   HttpServer server;
-  server.config.port = ParamUtils::readParameterPortNumber();
+  server.config.port = config->portNumber;
+  server.config.thread_pool_size = config->httpThreads;
+  httpWorkerPool.start(config->httpWorkers, config->httpQueueLimit);
 
   // Add resources using path-regex and method-string, and an anonymous function
   // POST-example for the path /string, responds the posted string
@@ -47,22 +203,42 @@ void HttpServerInstance::run() {
     // response->write(content);
   };
 
-  server.resource["^/config$"]["POST"] = [](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
-    try {
-        std::string conf = request->content.string();
-        std::string resp = tvPortSlots.uploadConfig(conf);
+  server.resource["^/config$"]["POST"] = [&server](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+    runOnWorker(server, response, [request](std::shared_ptr<HttpServer::Response>& response, SimpleWeb::CaseInsensitiveMultimap& header) {
+      try {
+          std::string conf = request->content.string();
+          std::string resp = tvPortSlots.uploadConfig(conf);
+          response->write(resp, header);
+      }
+      catch(const std::exception &e) {
+          response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what(), header);
+      }
+    });
+  };
 
-      *response << "HTTP/1.1 200 OK\r\n"
-                << "Content-Length: " << resp.length() << "\r\n\r\n"
-                << resp;
-    }
-    catch(const std::exception &e) {
-      *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
-                << e.what();
-    }
+  // the playlist is uploaded ahead of time, it is shown only after /activate with the id of the reply
+  server.resource["^/stage$"]["POST"] = [&server](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+    runOnWorker(server, response, [request](std::shared_ptr<HttpServer::Response>& response, SimpleWeb::CaseInsensitiveMultimap& header) {
+      try {
+          std::string conf = request->content.string();
+          std::string resp = tvPortSlots.uploadConfig(conf, false);
+          response->write(resp, header);
+      }
+      catch(const std::exception &e) {
+          response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what(), header);
+      }
+    });
   };
 
-  server.resource["^/padding$"]["POST"] = [](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+  server.resource["^/activate/([0-9]+)$"]["POST"] = [&server](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+      int id = ParamUtils::readIntegerFromBuffer((char*)request->path_match[1].str().c_str());
+      runOnWorker(server, response, [id](std::shared_ptr<HttpServer::Response>& response, SimpleWeb::CaseInsensitiveMultimap& header) {
+          response->write(tvPortSlots.activatePlaylist(id), header);
+      });
+  };
+
+  server.resource["^/padding$"]["POST"] = [&server](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+    runOnWorker(server, response, [request](std::shared_ptr<HttpServer::Response>& response, SimpleWeb::CaseInsensitiveMultimap& header) {
       // Retrieve string:
       std::string body = request->content.string();
       int wrongValue = -1000;
@@ -71,41 +247,53 @@ void HttpServerInstance::run() {
       int top = readIntValueInParams(body, "t", wrongValue);
       int bottom = readIntValueInParams(body, "b", wrongValue);
       std::string content = "";
-      if (left > wrongValue) {
-          ParamUtils::writeParameterPaddingLeft(left);
-      }
-      else {
+      if (left <= wrongValue) {
           content += "<h4>Wrong left padding</h4>";
       }
-      if (right > wrongValue) {
-          ParamUtils::writeParameterPaddingRight(right);
-      }
-      else {
+      if (right <= wrongValue) {
           content += "<h4>Wrong right padding</h4>";
       }
-      if (top > wrongValue) {
-          ParamUtils::writeParameterPaddingTop(top);
-      }
-      else {
+      if (top <= wrongValue) {
           content += "<h4>Wrong top padding</h4>";
       }
-      if (bottom > wrongValue) {
-          ParamUtils::writeParameterPaddingBottom(bottom);
-      }
-      else {
+      if (bottom <= wrongValue) {
           content += "<h4>Wrong bottom padding</h4>";
       }
+      // background color and upscaling are optional
+      int color = readColorValueInParams(body, "c", wrongValue);
+      int noUpscale = readIntValueInParams(body, "u", wrongValue);
+      // all of the correct values are published at once, the screen never shows a half of them
+      bool written = tvConfigStore.update([=](TvConfig& config) {
+          if (left > wrongValue) {
+              config.paddingLeft = left;
+          }
+          if (right > wrongValue) {
+              config.paddingRight = right;
+          }
+          if (top > wrongValue) {
+              config.paddingTop = top;
+          }
+          if (bottom > wrongValue) {
+              config.paddingBottom = bottom;
+          }
+          if (color > wrongValue) {
+              config.backgroundColor = color;
+          }
+          if (noUpscale > wrongValue) {
+              config.noUpscale = noUpscale > 0 ? 1 : 0;
+          }
+      });
+      if (!written) {
+          content += "<h4>The parameters cannot be saved, they are lost at restart</h4>";
+      }
       if (content == "") {
           content = "<script>window.location.href ='/';</script>";
       }
       content += "<a href='/'>Tilbake</a>";
-      *response << "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " << content.length() << "\r\n\r\n"
-          << content;
-
-
-      // Alternatively, use one of the convenience functions, for instance:
-      // response->write(content);
-      };
+      header.emplace("Content-Type", "text/html; charset=utf-8");
+      response->write(content, header);
+    });
+  };
 
 
   // Responds with request-information
@@ -115,6 +303,18 @@ void HttpServerInstance::run() {
 
     stream << "\"padding\":[" << tvPortSlots.getAllPaddings() << "],";
 
+    stream << "\"background\":\"" << tvPortSlots.getBackgroundColor() << "\",";
+
+    stream << "\"noUpscale\":" << tvConfigStore.get()->noUpscale << ",";
+
+    stream << "\"switchLatencyMs\":" << tvPortSlots.getSwitchLatency() << ",";
+
+    stream << "\"httpQueued\":" << httpWorkerPool.getQueued() << ",";
+
+    stream << "\"httpQueueDelayMs\":" << httpWorkerPool.getLastDelay() << ",";
+
+    stream << "\"playlists\":[" << tvPortSlots.getPlaylists() << "],";
+
     stream << "\"files\":[" << tvPortSlots.getCurrentSlotFiles() << "],";
 
     stream << "\"durations\":[" << tvPortSlots.getCurrentSlotDurations() << "]}";
@@ -128,26 +328,55 @@ void HttpServerInstance::run() {
       response->write(stream);
       };
 
-  server.resource["^/upload/([0-9,_]+)$"]["POST"] = [](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
-      std::string nr = request->path_match[1];
-      int offset1 = nr.find('_');
-      if (offset1 == std::string::npos) {
-          response->write("url must contain _");
+  // the content of the uploads is written to the file while it is read, see TvUploadSink
+  server.on_content_stream = [](std::shared_ptr<HttpServer::Request> request, unsigned long long /*contentLength*/) -> std::shared_ptr<SimpleWeb::ContentSink> {
+      static const std::regex uploadPath("^/upload/([0-9,_]+)$");
+      std::smatch match;
+      if (request->method != "POST" || !std::regex_match(request->path, match, uploadPath)) {
+          return nullptr;
+      }
+      auto sink = std::make_shared<TvUploadSink>();
+      std::string nrUpload;
+      long long amount;
+      sink->reply = parseUploadNumber(match[1], nrUpload, amount);
+      if (sink->reply.empty()) {
+          sink->start(nrUpload, amount);
+      }
+      return sink;
+      };
+
+  // the pieces of the upload are written by a worker while they come, the checks and the rename at the end run on a worker too
+  server.resource["^/upload/([0-9,_]+)$"]["POST"] = [&server](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+    if (request->content_sink && std::static_pointer_cast<TvUploadSink>(request->content_sink)->isRefused()) {
+        SimpleWeb::CaseInsensitiveMultimap header;
+        header.emplace("Retry-After", "1");
+        response->write(SimpleWeb::StatusCode::server_error_service_unavailable, "The server is busy, try again later", header);
+        return;
+    }
+    runOnWorker(server, response, [request](std::shared_ptr<HttpServer::Response>& response, SimpleWeb::CaseInsensitiveMultimap& header) {
+      if (request->content_sink) {
+          auto sink = std::static_pointer_cast<TvUploadSink>(request->content_sink);
+          response->write(sink->reply.empty() ? tvPortSlots.finishUpload(sink->upload) : sink->reply, header);
+          return;
+      }
+      // the content came in chunked transfer encoding, so it is already in memory
+      std::string nrUpload;
+      long long amount;
+      std::string error = parseUploadNumber(request->path_match[1], nrUpload, amount);
+      if (!error.empty()) {
+          response->write(error, header);
           return;
       }
-      int offset2 = nr.find('_', offset1 + 1);
-      if (offset2 == std::string::npos) {
-          response->write("url must contain _ and _");
+      if (amount <= 0 || static_cast<size_t>(amount) > request->content.size()) {
+          response->write("Error in the size of " + std::to_string(amount), header);
           return;
       }
-      std::string nrAmount = nr.substr(offset2 + 1);
-      int amount = std::stoi(nrAmount);
-      std::string nrUpload = nr.substr(0, offset2);
       std::unique_ptr<char[]> buffer(new char[amount]);
       char* data = buffer.get();
       request->content.read(data, static_cast<std::streamsize>(amount));
       std::string res = tvPortSlots.uploadFile(nrUpload, amount, data);
-      response->write(res);
+      response->write(res, header);
+    });
   };
 
  
@@ -156,83 +385,67 @@ void HttpServerInstance::run() {
   // Will respond with content in the web/-directory, and its subdirectories.
   // Default file: index.html
   // Can for instance be used to retrieve an HTML 5 client that uses REST-resources on this server
-  server.default_resource["GET"] = [](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
-    try {
-        std::string filePath = request->path;
-        auto web_root_path = boost::filesystem::canonical(detectWebFolderName(filePath));
-        filePath = getWebRestPath(filePath);
-        auto path = boost::filesystem::canonical(web_root_path / filePath);
-      // Check if path is within web_root_path
-      if(std::distance(web_root_path.begin(), web_root_path.end()) > std::distance(path.begin(), path.end()) ||
-         !std::equal(web_root_path.begin(), web_root_path.end(), path.begin()))
-        throw std::invalid_argument("path must be within root path");
-      if(boost::filesystem::is_directory(path))
-        path /= "index.html";
-
-      SimpleWeb::CaseInsensitiveMultimap header;
-
-      // Uncomment the following line to enable Cache-Control
-      // header.emplace("Cache-Control", "max-age=86400");
-
-#ifdef HAVE_OPENSSL
-//    Uncomment the following lines to enable ETag
-//    {
-//      ifstream ifs(path.string(), ifstream::in | ios::binary);
-//      if(ifs) {
-//        auto hash = SimpleWeb::Crypto::to_hex_string(SimpleWeb::Crypto::md5(ifs));
-//        header.emplace("ETag", "\"" + hash + "\"");
-//        auto it = request->header.find("If-None-Match");
-//        if(it != request->header.end()) {
-//          if(!it->second.empty() && it->second.compare(1, hash.size(), hash) == 0) {
-//            response->write(SimpleWeb::StatusCode::redirection_not_modified, header);
-//            return;
-//          }
-//        }
-//      }
-//      else
-//        throw invalid_argument("could not read file");
-//    }
-#endif
-
-      auto ifs = std::make_shared<std::ifstream>();
-      ifs->open(path.string(), std::ifstream::in | std::ios::binary | std::ios::ate);
+  server.default_resource["GET"] = [&server](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+    runOnWorker(server, response, [request, io = server.io_service](std::shared_ptr<HttpServer::Response>& response, SimpleWeb::CaseInsensitiveMultimap& header) {
+      try {
+        std::string path = tvStaticFiles.getResolvedPath(request->path);
+        if(path.empty()) {
+          path = resolveWebPath(request->path);
+          tvStaticFiles.addResolvedPath(request->path, path);
+        }
+        auto ifNoneMatch = request->header.find("If-None-Match");
+        // the media of a slot never changes under its name, it is not looked at when the browser has it
+        unsigned long long nameLength = 0;
+        std::string nameTag = detectWebFolderName(request->path) == "0" ? "" : TvStaticFiles::getNameTag(path, nameLength);
+        if(!nameTag.empty()) {
+          header.emplace("ETag", nameTag);
+          header.emplace("Cache-Control", "public, max-age=31536000, immutable");
+          if(ifNoneMatch != request->header.end() && TvStaticFiles::matchesTag(ifNoneMatch->second, nameTag)) {
+            header.emplace("Content-Length", std::to_string(nameLength));
+            response->write(SimpleWeb::StatusCode::redirection_not_modified, header);
+            return;
+          }
+        }
+        TvStaticFile file;
+        if(!tvStaticFiles.find(path, file)) {
+          tvStaticFiles.forgetResolvedPath(request->path);
+          throw std::invalid_argument("could not read file");
+        }
+        if(nameTag.empty()) {
+          // the web assets and config.json may change, the browser asks each time and gets 304 while they are the same
+          header.emplace("ETag", file.tag);
+          header.emplace("Cache-Control", "no-cache");
+          if(ifNoneMatch != request->header.end() && TvStaticFiles::matchesTag(ifNoneMatch->second, file.tag)) {
+            header.emplace("Content-Length", std::to_string(file.size));
+            response->write(SimpleWeb::StatusCode::redirection_not_modified, header);
+            return;
+          }
+        }
 
-      if(*ifs) {
-        auto length = ifs->tellg();
-        ifs->seekg(0, std::ios::beg);
-        std::string contentType = detectContentType(path.string());
-        header.emplace("Content-Type", contentType);
-        header.emplace("Content-Length", to_string(length));
+        header.emplace("Content-Type", detectContentType(path));
+        if(file.content) {
+          response->write(*file.content, header);
+          return;
+        }
+        auto content = std::make_shared<SimpleWeb::FileContent>();
+        if(!content->open(path)) {
+          tvStaticFiles.forgetResolvedPath(request->path);
+          throw std::invalid_argument("could not read file");
+        }
+        header.emplace("Content-Length", std::to_string(content->size()));
         response->write(header);
-
-        // Trick to define a recursive function within this scope (for example purposes)
-        class FileServer {
-        public:
-          static void read_and_send(const std::shared_ptr<HttpServer::Response> &response, const std::shared_ptr<std::ifstream> &ifs) {
-            // Read and send 128 KB at a time
-            static std::vector<char> buffer(131072); // Safe when server is running on one thread
-            std::streamsize read_length;
-            if((read_length = ifs->read(&buffer[0], static_cast<std::streamsize>(buffer.size())).gcount()) > 0) {
-              response->write(&buffer[0], read_length);
-              if(read_length == static_cast<std::streamsize>(buffer.size())) {
-                response->send([response, ifs](const SimpleWeb::error_code &ec) {
-                  if(!ec)
-                    read_and_send(response, ifs);
-                  else
-                    std::cerr << "Connection interrupted" << std::endl;
-                });
-              }
-            }
-          }
-        };
-        FileServer::read_and_send(response, ifs);
+        // the file goes from the disk to the socket without passing through a buffer, the io thread only waits for the socket
+        boost::asio::post(*io, [response, content]() {
+          response->send_file(content, [](const SimpleWeb::error_code &ec) {
+            if(ec)
+              std::cerr << "Connection interrupted" << std::endl;
+          });
+        });
       }
-      else
-        throw std::invalid_argument("could not read file");
-    }
-    catch(const std::exception &e) {
-      response->write(SimpleWeb::StatusCode::client_error_bad_request, "Could not open path " + request->path + ": " + e.what());
-    }
+      catch(const std::exception &e) {
+        response->write(SimpleWeb::StatusCode::client_error_bad_request, "Could not open path " + request->path + ": " + e.what(), header);
+      }
+    });
   };
 
   server.on_error = [](std::shared_ptr<HttpServer::Request> /*request*/, const SimpleWeb::error_code & /*ec*/) {
@@ -249,6 +462,26 @@ void HttpServerInstance::run() {
   std::cout << "Http server either could not start or was stopped" << std::endl;
 }
 
+// nr is <file no>_<position>_<size>, nrUpload gets <file no>_<position>
+std::string HttpServerInstance::parseUploadNumber(std::string nr, std::string& nrUpload, long long& amount) {
+    size_t offset1 = nr.find('_');
+    if (offset1 == std::string::npos) {
+        return "url must contain _";
+    }
+    size_t offset2 = nr.find('_', offset1 + 1);
+    if (offset2 == std::string::npos) {
+        return "url must contain _ and _";
+    }
+    try {
+        amount = std::stoll(nr.substr(offset2 + 1));
+    }
+    catch (const std::exception&) {
+        return "url must end with the size";
+    }
+    nrUpload = nr.substr(0, offset2);
+    return "";
+}
+
 bool HttpServerInstance::port_in_use(unsigned short port) {
     using namespace boost::asio;
     using ip::tcp;
@@ -265,7 +498,7 @@ bool HttpServerInstance::port_in_use(unsigned short port) {
 void HttpServerInstance::httpClientTest() {
   std::this_thread::sleep_for(std::chrono::seconds(1));
   char clientUrlPath[40];
-  int portNumber = ParamUtils::readParameterPortNumber();
+  int portNumber = tvConfigStore.get()->portNumber;
   sprintf_s(clientUrlPath, "localhost:%d", portNumber);
   // Client 
   HttpClient client(clientUrlPath);
@@ -341,50 +574,48 @@ std::string HttpServerInstance::detectContentType(std::string url) {
     return "text/html; charset=utf-8";
 }
 
-std::string HttpServerInstance::detectWebFolderName(std::string url)
+// the length of the slot number in front of the first '/' of the url, 0 when the url does not start with a slot
+size_t HttpServerInstance::getWebSlotLength(const std::string& url, size_t pos)
 {
-    if (url.size() > 2)
+    size_t end = pos;
+    while (end < url.size() && end - pos < 3 && url.at(end) >= '0' && url.at(end) <= '9')
     {
-        int pos = 0;
-        if (url.at(0) == '/')
-        {
-            pos++;
-        }
-        if (url.at(pos + 1) == '/')
-        {
-            char c = url.at(pos);
-            if (c=='1') 
-            {
-                return "1";
-            }
-            if (c == '2')
-            {
-                return "2";
-            }
-        }
+        end++;
     }
-    return "0";
+    if (end == pos || end >= url.size() || url.at(end) != '/')
+    {
+        return 0;
+    }
+    int slot = ParamUtils::readIntegerFromBuffer((char*)url.substr(pos, end - pos).c_str());
+    return slot <= TVPORT_MAXIMUM_SLOT_NUMBER ? end - pos : 0;
+}
+
+std::string HttpServerInstance::detectWebFolderName(std::string url)
+{
+    size_t pos = !url.empty() && url.at(0) == '/' ? 1 : 0;
+    size_t length = getWebSlotLength(url, pos);
+    return length > 0 ? url.substr(pos, length) : "0";
 }
 
 std::string HttpServerInstance::getWebRestPath(std::string url)
 {
-    if (url.size() > 2)
-    {
-        int pos = 0;
-        if (url.at(0) == '/')
-        {
-            pos++;
-        }
-        if (url.at(pos + 1) == '/')
-        {
-            char c = url.at(pos);
-            if (c == '1' || c=='2' || c=='0')
-            {
-                return url.substr(pos+2);
-            }
-        }
-    }
-    return url;
+    size_t pos = !url.empty() && url.at(0) == '/' ? 1 : 0;
+    size_t length = getWebSlotLength(url, pos);
+    return length > 0 ? url.substr(pos + length + 1) : url;
+}
+
+// the file of the url in its web folder, a folder gives its index.html
+std::string HttpServerInstance::resolveWebPath(std::string url)
+{
+    auto web_root_path = boost::filesystem::canonical(detectWebFolderName(url));
+    auto path = boost::filesystem::canonical(web_root_path / getWebRestPath(url));
+    // Check if path is within web_root_path
+    if (std::distance(web_root_path.begin(), web_root_path.end()) > std::distance(path.begin(), path.end()) ||
+        !std::equal(web_root_path.begin(), web_root_path.end(), path.begin()))
+        throw std::invalid_argument("path must be within root path");
+    if (boost::filesystem::is_directory(path))
+        path /= "index.html";
+    return path.string();
 }
 
 int HttpServerInstance::readIntValueInParams(std::string body, std::string param, int defValue)
@@ -400,3 +631,29 @@ int HttpServerInstance::readIntValueInParams(std::string body, std::string param
     }
     return defValue;
 }
+
+// the color is given as RRGGBB in hex, optionally with # (%23 in a form) in front of it
+int HttpServerInstance::readColorValueInParams(std::string body, std::string param, int defValue)
+{
+    int pos = body.find(param + "=");
+    if (pos != std::string::npos)
+    {
+        int startPos = pos + param.size() + 1;
+        int endPos = body.find("&", startPos);
+        std::string val = endPos == std::string::npos ? body.substr(startPos) : body.substr(startPos, endPos - startPos);
+        if (val.rfind("%23", 0) == 0)
+        {
+            val = val.substr(3);
+        }
+        else if (val.rfind("#", 0) == 0)
+        {
+            val = val.substr(1);
+        }
+        int color;
+        if (val.size() == 6 && sscanf_s(val.c_str(), "%x", &color) == 1)
+        {
+            return color;
+        }
+    }
+    return defValue;
+}
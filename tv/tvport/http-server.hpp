@@ -9,9 +9,13 @@ public:
 	static void runWithSelfTest();
 	static bool port_in_use(unsigned short port);
 	static std::string detectContentType(std::string url);
+	static size_t getWebSlotLength(const std::string& url, size_t pos);
 	static std::string detectWebFolderName(std::string url);
 	static std::string getWebRestPath(std::string url);
+	static std::string resolveWebPath(std::string url);
 	static int readIntValueInParams(std::string body, std::string param, int defValue);
+	static int readColorValueInParams(std::string body, std::string param, int defValue);
+	static std::string parseUploadNumber(std::string nr, std::string& nrUpload, long long& amount);
 };
 
 #endif
@@ -0,0 +1,107 @@
+/*************************************************************
+TvHttpWorkerPool runs the http handlers which touch the disk (config, uploads, files), so the io threads of the server
+only read and write the sockets, and /status and /info are answered while a big upload is checked or a slot is cleaned.
+The queue is bounded: a handler which does not fit is refused, the server answers 503 and the master tries again later.
+Every job gets its queueing delay, the time from submit to its start, the handlers send it back in X-Queue-Delay-Ms.
+**************************************************************/
+
+#ifndef TVPORT_HTTP_WORKER_POOL_HPP
+#define TVPORT_HTTP_WORKER_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TvHttpWorkerPool
+{
+	struct Job {
+		// gets the queueing delay in ms
+		std::function<void(double)> work;
+		std::chrono::steady_clock::time_point submitted;
+	};
+
+	std::mutex poolMutex;
+	std::condition_variable poolCondition;
+	std::deque<Job> jobs;
+	std::vector<std::thread> workers;
+	size_t maximumQueued = 0;
+	bool stopping = false;
+	// in microseconds, of the last started job
+	std::atomic<long long> lastDelay{ 0 };
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		while (true)
+		{
+			poolCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+			{
+				break;
+			}
+			Job job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+			long long delay = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.submitted).count();
+			lastDelay = delay;
+			job.work(delay / 1000.0);
+			lock.lock();
+		}
+	}
+
+public:
+	void start(int threads, size_t maximum)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		maximumQueued = maximum;
+		for (int i = (int)workers.size(); i < threads; i++)
+		{
+			workers.emplace_back(&TvHttpWorkerPool::run, this);
+		}
+	}
+
+	// false when the queue is full, the work is not done then
+	bool submit(std::function<void(double)> work)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (jobs.size() >= maximumQueued || workers.empty())
+		{
+			return false;
+		}
+		jobs.push_back(Job{ std::move(work), std::chrono::steady_clock::now() });
+		poolCondition.notify_one();
+		return true;
+	}
+
+	size_t getQueued()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return jobs.size();
+	}
+
+	// in ms
+	double getLastDelay()
+	{
+		return lastDelay.load() / 1000.0;
+	}
+
+	~TvHttpWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			stopping = true;
+			poolCondition.notify_all();
+		}
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+};
+
+#endif
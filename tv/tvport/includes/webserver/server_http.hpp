@@ -2,6 +2,7 @@
 #define SERVER_HTTP_HPP
 
 #include "utility.hpp"
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <limits>
@@ -11,6 +12,14 @@
 #include <thread>
 #include <unordered_set>
 
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifdef USE_STANDALONE_ASIO
 #include <asio.hpp>
 #include <asio/steady_timer.hpp>
@@ -47,6 +56,105 @@ namespace SimpleWeb {
   template <class socket_type>
   class Server;
 
+  /// Receives the content of a request piece by piece while it is read from the socket,
+  /// so the content is never held in memory as a whole. See ServerBase::on_content_stream.
+  /// The sink may hand the pieces to other threads, the reading from the socket waits while it is full.
+  class ContentSink {
+  public:
+    virtual ~ContentSink() noexcept = default;
+    /// The place where the next piece of the content is read to.
+    virtual std::pair<char *, std::size_t> buffer() = 0;
+    /// The next size bytes of the content have been read to buffer().
+    /// Returns false when the sink cannot take the next piece yet, it calls resume from any thread when it can.
+    virtual bool write(std::size_t size, std::function<void()> resume) = 0;
+    /// The last piece has been written, the sink calls done from any thread when it has handled all pieces.
+    virtual void finish(std::function<void()> done) = 0;
+  };
+
+  /// An open file sent as the content of a response, see Response::send_file.
+  /// It is opened for reading only, and it can be deleted while it is sent.
+  class FileContent {
+  public:
+#ifdef _WIN32
+    using native_handle_type = HANDLE;
+#else
+    using native_handle_type = int;
+#endif
+
+    FileContent() noexcept = default;
+    FileContent(const FileContent &) = delete;
+    FileContent &operator=(const FileContent &) = delete;
+    ~FileContent() noexcept {
+      close();
+    }
+
+    /// Returns false when the file cannot be opened.
+    bool open(const std::string &path) noexcept {
+      close();
+#ifdef _WIN32
+      handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      LARGE_INTEGER length;
+      if(handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &length)) {
+        close();
+        return false;
+      }
+      file_size = static_cast<unsigned long long>(length.QuadPart);
+#else
+      handle = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat status;
+      if(handle < 0 || fstat(handle, &status) != 0) {
+        close();
+        return false;
+      }
+      file_size = static_cast<unsigned long long>(status.st_size);
+#endif
+      return true;
+    }
+
+    void close() noexcept {
+#ifdef _WIN32
+      if(handle != INVALID_HANDLE_VALUE)
+        CloseHandle(handle);
+      handle = INVALID_HANDLE_VALUE;
+#else
+      if(handle >= 0)
+        ::close(handle);
+      handle = -1;
+#endif
+      file_size = 0;
+    }
+
+    /// Reads at most size bytes from offset, returns the number of the bytes read.
+    std::size_t read(char *buffer, std::size_t size, unsigned long long offset) noexcept {
+#ifdef _WIN32
+      OVERLAPPED overlapped = {};
+      overlapped.Offset = static_cast<DWORD>(offset);
+      overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+      DWORD read_size = 0;
+      return ReadFile(handle, buffer, static_cast<DWORD>(size), &read_size, &overlapped) ? read_size : 0;
+#else
+      ssize_t read_size = ::pread(handle, buffer, size, static_cast<off_t>(offset));
+      return read_size > 0 ? static_cast<std::size_t>(read_size) : 0;
+#endif
+    }
+
+    unsigned long long size() const noexcept {
+      return file_size;
+    }
+
+    native_handle_type native_handle() const noexcept {
+      return handle;
+    }
+
+  private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int handle = -1;
+#endif
+    unsigned long long file_size = 0;
+  };
+
   template <class socket_type>
   class ServerBase {
   protected:
@@ -82,6 +190,78 @@ namespace SimpleWeb {
           *this << "\r\n";
       }
 
+      /// The part of the file from offset, the system copies it from the file to the socket.
+      /// The handler gets the number of the bytes sent, 0 when the socket was not ready and the part is tried again.
+      template <typename handler_type>
+      void transmit_file_part(asio::ip::tcp::socket &socket, FileContent &file, unsigned long long offset, handler_type handler) {
+        // TransmitFile sends at most 2^31 - 2 bytes in one call
+        auto size = std::min<unsigned long long>(file.size() - offset, 1u << 30);
+#ifdef _WIN32
+        asio::windows::overlapped_ptr overlapped(socket.get_executor(), handler);
+        overlapped.get()->Offset = static_cast<DWORD>(offset);
+        overlapped.get()->OffsetHigh = static_cast<DWORD>(offset >> 32);
+        BOOL ok = ::TransmitFile(socket.native_handle(), file.native_handle(), static_cast<DWORD>(size), 0, overlapped.get(), nullptr, 0);
+        DWORD last_error = ::GetLastError();
+        if(!ok && last_error != ERROR_IO_PENDING)
+          overlapped.complete(error_code(static_cast<int>(last_error), asio::error::get_system_category()), 0);
+        else
+          overlapped.release();
+#else
+        error_code ec;
+        socket.native_non_blocking(true, ec);
+        if(ec) {
+          asio::post(socket.get_executor(), [handler, ec]() mutable { handler(ec, 0); });
+          return;
+        }
+        off_t position = static_cast<off_t>(offset);
+        ssize_t sent = ::sendfile(socket.native_handle(), file.native_handle(), &position, static_cast<std::size_t>(size));
+        if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          socket.async_wait(asio::ip::tcp::socket::wait_write, [handler](const error_code &ec) mutable { handler(ec, 0); });
+          return;
+        }
+        // 0 means the file has become shorter than its size
+        if(sent <= 0)
+          ec = sent == 0 ? make_error_code::make_error_code(errc::io_error) : error_code(errno, asio::error::get_system_category());
+        asio::post(socket.get_executor(), [handler, ec, sent]() mutable { handler(ec, ec ? 0 : static_cast<std::size_t>(sent)); });
+#endif
+      }
+
+      /// The part of the file from offset through the stream buffer, on the sockets the system cannot copy a file to (https).
+      template <typename other_socket_type, typename handler_type>
+      void transmit_file_part(other_socket_type &socket, FileContent &file, unsigned long long offset, handler_type handler) {
+        auto size = static_cast<std::size_t>(std::min<unsigned long long>(file.size() - offset, 131072));
+        auto buffer = streambuf.prepare(size);
+        auto read_size = file.read(static_cast<char *>(buffer.data()), size, offset);
+        if(read_size == 0) {
+          asio::post(socket.get_executor(), [handler]() mutable { handler(make_error_code::make_error_code(errc::io_error), 0); });
+          return;
+        }
+        streambuf.commit(read_size);
+        asio::async_write(socket, streambuf, handler);
+      }
+
+      void send_file_part(const std::shared_ptr<FileContent> &file, unsigned long long offset, const std::function<void(const error_code &)> &callback) noexcept {
+        if(offset >= file->size()) {
+          if(callback)
+            callback(error_code());
+          return;
+        }
+        session->connection->set_timeout(timeout_content);
+        auto self = this->shared_from_this(); // Keep Response instance alive through the following transfer
+        transmit_file_part(*session->connection->socket, *file, offset, [self, file, offset, callback](const error_code &ec, std::size_t bytes_transferred) {
+          self->session->connection->cancel_timeout();
+          auto lock = self->session->connection->handler_runner->continue_lock();
+          if(!lock)
+            return;
+          if(ec) {
+            if(callback)
+              callback(ec);
+            return;
+          }
+          self->send_file_part(file, offset + bytes_transferred, callback);
+        });
+      }
+
     public:
       std::size_t size() noexcept {
         return streambuf.size();
@@ -101,6 +281,21 @@ namespace SimpleWeb {
         });
       }
 
+      /// Sends the stream buffer, the status line and the header with the Content-Length of the file, and then the file.
+      /// The file does not pass through the memory of the process on a plain tcp socket (sendfile, TransmitFile).
+      /// Must be called from a thread of the io_service, like send.
+      void send_file(const std::shared_ptr<FileContent> &file, const std::function<void(const error_code &)> &callback = nullptr) noexcept {
+        auto self = this->shared_from_this();
+        send([self, file, callback](const error_code &ec) {
+          if(ec) {
+            if(callback)
+              callback(ec);
+            return;
+          }
+          self->send_file_part(file, 0, callback);
+        });
+      }
+
       /// Write directly to stream buffer using std::ostream::write
       void write(const char_type *ptr, std::streamsize n) {
         std::ostream::write(ptr, n);
@@ -198,6 +393,9 @@ namespace SimpleWeb {
 
       regex::smatch path_match;
 
+      /// Set when the content was streamed to the sink returned by on_content_stream, the content is empty then.
+      std::shared_ptr<ContentSink> content_sink;
+
       std::shared_ptr<asio::ip::tcp::endpoint> remote_endpoint;
 
       /// The time point when the request header was fully read.
@@ -334,6 +532,10 @@ namespace SimpleWeb {
 
     std::function<void(std::unique_ptr<socket_type> &, std::shared_ptr<typename ServerBase<socket_type>::Request>)> on_upgrade;
 
+    /// Called when the header of a request with Content-Length is parsed. If it returns a sink,
+    /// the content is passed to the sink piece by piece instead of being buffered, and the resource is called after the sink is done with the last piece.
+    std::function<std::shared_ptr<ContentSink>(std::shared_ptr<typename ServerBase<socket_type>::Request>, unsigned long long)> on_content_stream;
+
     /// If you have your own asio::io_service, store its pointer here before running start().
     std::shared_ptr<asio::io_service> io_service;
 
@@ -499,6 +701,14 @@ namespace SimpleWeb {
                 this->on_error(session->request, make_error_code::make_error_code(errc::protocol_error));
               return;
             }
+            if(this->on_content_stream && content_length > 0) {
+              auto sink = this->on_content_stream(session->request, content_length);
+              if(sink) {
+                session->request->content_sink = std::move(sink);
+                this->read_content_stream(session, content_length);
+                return;
+              }
+            }
             if(content_length > num_additional_bytes) {
               session->connection->set_timeout(config.timeout_content);
               asio::async_read(*session->connection->socket, session->request->streambuf, asio::transfer_exactly(content_length - num_additional_bytes), [this, session](const error_code &ec, std::size_t /*bytes_transferred*/) {
@@ -536,6 +746,61 @@ namespace SimpleWeb {
       });
     }
 
+    void read_content_stream(const std::shared_ptr<Session> &session, unsigned long long remaining) {
+      auto &sink = *session->request->content_sink;
+      // The bytes of the content which came together with the header
+      while(session->request->streambuf.size() > 0 && remaining > 0) {
+        auto buffer = sink.buffer();
+        auto size = static_cast<std::size_t>(std::min<unsigned long long>(std::min(session->request->streambuf.size(), buffer.second), remaining));
+        session->request->content.read(buffer.first, static_cast<std::streamsize>(size));
+        remaining -= size;
+        if(!sink.write(size, resume_content_stream(session, remaining)))
+          return;
+      }
+      read_content_piece(session, remaining);
+    }
+
+    /// The reading goes on in a thread of the io_service, when the sink can take the next piece.
+    std::function<void()> resume_content_stream(const std::shared_ptr<Session> &session, unsigned long long remaining) {
+      return [this, session, remaining]() {
+        asio::post(*io_service, [this, session, remaining]() {
+          auto lock = session->connection->handler_runner->continue_lock();
+          if(!lock)
+            return;
+          this->read_content_stream(session, remaining);
+        });
+      };
+    }
+
+    void read_content_piece(const std::shared_ptr<Session> &session, unsigned long long remaining) {
+      if(remaining == 0) {
+        session->request->content_sink->finish([this, session]() {
+          asio::post(*io_service, [this, session]() {
+            auto lock = session->connection->handler_runner->continue_lock();
+            if(!lock)
+              return;
+            this->find_resource(session);
+          });
+        });
+        return;
+      }
+      auto buffer = session->request->content_sink->buffer();
+      auto size = static_cast<std::size_t>(std::min<unsigned long long>(buffer.second, remaining));
+      session->connection->set_timeout(config.timeout_content);
+      session->connection->socket->async_read_some(asio::buffer(buffer.first, size), [this, session, remaining](const error_code &ec, std::size_t bytes_transferred) {
+        session->connection->cancel_timeout();
+        auto lock = session->connection->handler_runner->continue_lock();
+        if(!lock)
+          return;
+        if(!ec) {
+          if(session->request->content_sink->write(bytes_transferred, this->resume_content_stream(session, remaining - bytes_transferred)))
+            this->read_content_piece(session, remaining - bytes_transferred);
+        }
+        else if(this->on_error)
+          this->on_error(session->request, ec);
+      });
+    }
+
     void read_chunked_transfer_encoded(const std::shared_ptr<Session> &session, const std::shared_ptr<asio::streambuf> &chunks_streambuf) {
       session->connection->set_timeout(config.timeout_content);
       asio::async_read_until(*session->connection->socket, session->request->streambuf, "\r\n", [this, session, chunks_streambuf](const error_code &ec, size_t bytes_transferred) {
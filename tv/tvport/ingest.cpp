@@ -0,0 +1,184 @@
+#include "ingest.hpp"
+#include "screen-layout.hpp"
+#include "raw-clip.hpp"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/videoio.hpp"
+#include <filesystem>
+#include <iostream>
+
+TvIngestWorker tvIngestWorker;
+
+std::string TvIngestWorker::getScaledFileName(const std::string& fileName)
+{
+    return fileName + "." + TvScreenLayout::getScaleTag() + ".mp4";
+}
+
+std::string TvIngestWorker::getRawFileName(const std::string& fileName)
+{
+    return fileName + "." + TvScreenLayout::getScaleTag() + ".raw";
+}
+
+// the writers of OpenCV choose the container by the extension, so ".part" goes before it
+std::string TvIngestWorker::getPartFileName(const std::string& targetName)
+{
+    size_t pointPos = targetName.rfind('.');
+    return targetName.substr(0, pointPos) + ".part" + targetName.substr(pointPos);
+}
+
+void TvIngestWorker::enqueue(const std::string& fileName)
+{
+    std::lock_guard<std::mutex> lock(ingestMutex);
+    if (!worker.joinable())
+    {
+        worker = std::thread(&TvIngestWorker::run, this);
+    }
+    jobs.push_back(fileName);
+    ingestCondition.notify_all();
+}
+
+void TvIngestWorker::run()
+{
+    std::unique_lock<std::mutex> lock(ingestMutex);
+    while (true)
+    {
+        ingestCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping)
+        {
+            break;
+        }
+        std::string fileName = jobs.front();
+        jobs.pop_front();
+        lock.unlock();
+        try {
+            scaleVideo(fileName);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Scaling of " << fileName << " failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+// all raw clips of all slots must fit into the disk budget
+bool TvIngestWorker::isRawClipWanted(double seconds, uint64_t bytes)
+{
+    std::shared_ptr<const TvConfig> config = tvConfigStore.get();
+    if (seconds <= 0 || seconds > config->rawClipSeconds)
+    {
+        return false;
+    }
+    uint64_t used = 0;
+    for (int slot = TVPORT_MINIMUM_SLOT_NUMBER; slot <= TVPORT_MAXIMUM_SLOT_NUMBER; slot++)
+    {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(std::to_string(slot), ec))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".raw")
+            {
+                used += entry.file_size();
+            }
+        }
+    }
+    return used + bytes <= (uint64_t)config->rawClipBudgetMb * 1024 * 1024;
+}
+
+void TvIngestWorker::scaleVideo(const std::string& fileName)
+{
+    std::string scaledName = getScaledFileName(fileName);
+    std::string rawName = getRawFileName(fileName);
+    if (std::filesystem::exists(scaledName) || std::filesystem::exists(rawName) || !std::filesystem::exists(fileName))
+    {
+        return;
+    }
+    cv::VideoCapture video(fileName);
+    cv::Mat frame, scaled;
+    if (!video.isOpened() || !video.read(frame) || frame.empty())
+    {
+        return;
+    }
+    float resizeFactor = TvScreenLayout::calculateScaleToResize(frame.size().width, frame.size().height, 0.05);
+    bool resizeRequired = resizeFactor > 0.0001;
+    cv::Size scaledSize = resizeRequired ? cv::Size(cv::saturate_cast<int>(frame.size().width * resizeFactor), cv::saturate_cast<int>(frame.size().height * resizeFactor)) : frame.size();
+    double fps = video.get(cv::CAP_PROP_FPS);
+    if (fps <= 0)
+    {
+        fps = 25.0;
+    }
+    double frameCount = video.get(cv::CAP_PROP_FRAME_COUNT);
+    uint64_t rawBytes = (uint64_t)(frameCount > 0 ? frameCount : 0) * scaledSize.area() * frame.elemSize();
+    bool makeRaw = isRawClipWanted(frameCount / fps, rawBytes);
+    if (!makeRaw && !resizeRequired)
+    {
+        return;
+    }
+    std::string targetName = makeRaw ? rawName : scaledName;
+    std::string partName = getPartFileName(targetName);
+    TvRawClipWriter rawWriter;
+    cv::VideoWriter writer;
+    bool opened = makeRaw ? rawWriter.open(partName, scaledSize, frame.type(), fps) : writer.open(partName, cv::VideoWriter::fourcc('m', 'p', '4', 'v'), fps, scaledSize);
+    if (!opened)
+    {
+        std::cout << "Cannot write the scaled video " << partName << std::endl;
+        return;
+    }
+    std::cout << (makeRaw ? "Making raw clip of " : "Scaling video ") << fileName << " to " << scaledSize.width << "x" << scaledSize.height << std::endl;
+    long frames = 0;
+    double timestamp = video.get(cv::CAP_PROP_POS_MSEC);
+    bool failed = false;
+    while (true)
+    {
+        if (resizeRequired)
+        {
+            cv::resize(frame, scaled, scaledSize, 0, 0, cv::INTER_CUBIC);
+        }
+        else {
+            scaled = frame;
+        }
+        if (makeRaw)
+        {
+            // the number of frames given by the container is only an estimation, the budget must hold anyway
+            failed = !rawWriter.write(scaled, timestamp) || (uint64_t)(frames + 1) * scaled.total() * scaled.elemSize() > rawBytes + rawBytes / 10;
+        }
+        else {
+            writer.write(scaled);
+        }
+        frames++;
+        if (stopping || failed || !video.read(frame) || frame.empty())
+        {
+            break;
+        }
+        double position = video.get(cv::CAP_PROP_POS_MSEC);
+        timestamp = position > timestamp ? position : timestamp + 1000.0 / fps;
+    }
+    if (makeRaw)
+    {
+        failed = !rawWriter.close() || failed;
+    }
+    else {
+        writer.release();
+    }
+    video.release();
+    std::error_code ec;
+    if (stopping || failed)
+    {
+        std::filesystem::remove(partName, ec);
+        return;
+    }
+    std::filesystem::rename(partName, targetName, ec);
+    std::cout << "Scaled video " << targetName << " has " << frames << " frames" << (ec ? ", but it cannot be renamed" : "") << std::endl;
+}
+
+TvIngestWorker::~TvIngestWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        stopping = true;
+        ingestCondition.notify_all();
+    }
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
@@ -0,0 +1,47 @@
+/*************************************************************
+TvIngestWorker scales the videos of a slot to the screen once, when the slot becomes ready,
+so the render thread can play them without resizing every frame.
+The scaled video is written on a background thread next to the original file,
+its name is the original name + "." + size of the content box and upscaling flag + ".mp4",
+first as ".part.mp4" and renamed when it is complete, so an unfinished file is never played.
+When the paddings or the screen resolution change, the name changes too and the video is scaled again.
+A video which does not need resizing is not copied.
+A short video (see raw-clip.hpp) is written as a raw clip instead, its name ends with ".raw",
+it is made also when the video does not need resizing.
+**************************************************************/
+
+#ifndef TVPORT_INGEST_HPP
+#define TVPORT_INGEST_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class TvIngestWorker
+{
+	std::mutex ingestMutex;
+	std::condition_variable ingestCondition;
+	std::deque<std::string> jobs;
+	std::thread worker;
+	std::atomic<bool> stopping{ false };
+
+	void run();
+	void scaleVideo(const std::string& fileName);
+	bool isRawClipWanted(double seconds, uint64_t bytes);
+
+public:
+	static std::string getScaledFileName(const std::string& fileName);
+	static std::string getRawFileName(const std::string& fileName);
+	// the name of the scaled copy or the raw clip while it is written
+	static std::string getPartFileName(const std::string& targetName);
+	void enqueue(const std::string& fileName);
+	~TvIngestWorker();
+};
+
+extern TvIngestWorker tvIngestWorker;
+
+#endif
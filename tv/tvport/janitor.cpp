@@ -0,0 +1,146 @@
+#include <chrono>
+#include <iostream>
+#include "janitor.hpp"
+#include "config-store.hpp"
+#include "media-store.hpp"
+
+TvJanitor tvJanitor;
+
+bool TvJanitor::push(Job job)
+{
+    std::lock_guard<std::mutex> lock(janitorMutex);
+    if (jobs.size() >= TVPORT_JANITOR_MAXIMUM_JOBS)
+    {
+        return false;
+    }
+    if (!worker.joinable())
+    {
+        worker = std::thread(&TvJanitor::run, this);
+    }
+    jobs.push_back(job);
+    janitorCondition.notify_all();
+    return true;
+}
+
+bool TvJanitor::enqueue(const std::filesystem::path& path)
+{
+    Job job;
+    job.path = path;
+    if (!push(job))
+    {
+        std::cout << "Janitor queue is full, " << path.string() << " stays until the next cleaning" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void TvJanitor::enqueueCollect()
+{
+    Job job;
+    job.path = TVPORT_MEDIA_STORE_FOLDER;
+    job.collect = true;
+    push(job);
+}
+
+void TvJanitor::cancel(const std::string& folder)
+{
+    std::filesystem::path folderPath(folder);
+    std::unique_lock<std::mutex> lock(janitorMutex);
+    for (auto it = jobs.begin(); it != jobs.end();)
+    {
+        it = !it->collect && it->path.parent_path() == folderPath ? jobs.erase(it) : std::next(it);
+    }
+    if (!removing.empty() && removing.parent_path() == folderPath)
+    {
+        // the file is removed at once, the config waiting for the folder does not wait for the rate
+        hurried = true;
+    }
+    janitorCondition.wait(lock, [this, &folderPath] { return removing.empty() || removing.parent_path() != folderPath; });
+}
+
+void TvJanitor::run()
+{
+    std::unique_lock<std::mutex> lock(janitorMutex);
+    while (true)
+    {
+        janitorCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping)
+        {
+            break;
+        }
+        Job job = jobs.front();
+        jobs.pop_front();
+        removing = job.collect ? std::filesystem::path() : job.path;
+        lock.unlock();
+        try {
+            if (job.collect)
+            {
+                for (const std::filesystem::path& path : TvMediaStore::takeUnreferenced())
+                {
+                    remove(path);
+                }
+            }
+            else {
+                remove(job.path);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Removing of " << job.path.string() << " failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+        removing.clear();
+        hurried = false;
+        janitorCondition.notify_all();
+    }
+}
+
+// sleeps as long as deleting of so many bytes may take by the rate
+void TvJanitor::pause(uintmax_t bytes)
+{
+    int rate = tvConfigStore.get()->janitorMbPerSecond;
+    if (rate <= 0 || stopping || hurried)
+    {
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(bytes / rate));
+}
+
+void TvJanitor::remove(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+    {
+        return;
+    }
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    // a shared file keeps its content for the other links
+    if (!ec && std::filesystem::hard_link_count(path, ec) == 1 && !ec)
+    {
+        while (size > TVPORT_JANITOR_STEP && !stopping && !hurried)
+        {
+            size -= TVPORT_JANITOR_STEP;
+            std::filesystem::resize_file(path, size, ec);
+            if (ec)
+            {
+                break;
+            }
+            pause(TVPORT_JANITOR_STEP);
+        }
+    }
+    std::filesystem::remove(path, ec);
+    pause(size);
+}
+
+TvJanitor::~TvJanitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(janitorMutex);
+        stopping = true;
+        janitorCondition.notify_all();
+    }
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
@@ -0,0 +1,62 @@
+/*************************************************************
+TvJanitor deletes the files of the slots on a background thread, so neither the render thread
+nor the http server waits for the file system when a slot is cleaned.
+The deletion is limited to janitor_mb_per_second.txt: a big file is truncated step by step before it is removed,
+and the janitor sleeps between the steps, so the storage keeps serving the screen meanwhile.
+A file which is hard linked into the media store is only unlinked, its content stays for the other links.
+The queue is bounded, the files which do not fit are left where they are and the next cleaning of their slot removes them.
+Before a slot folder is used again for a new config, cancel drops the queued files of that folder,
+and the file of that folder being removed is removed at once, without the steps and the pauses.
+**************************************************************/
+
+#ifndef TVPORT_JANITOR_HPP
+#define TVPORT_JANITOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TVPORT_JANITOR_MAXIMUM_JOBS 4096
+// in bytes, a big file is truncated by this step
+#define TVPORT_JANITOR_STEP (4 << 20)
+
+class TvJanitor
+{
+	struct Job {
+		std::filesystem::path path;
+		// the unreferenced files of the media store are looked for and removed
+		bool collect = false;
+	};
+
+	std::mutex janitorMutex;
+	std::condition_variable janitorCondition;
+	std::deque<Job> jobs;
+	std::filesystem::path removing;
+	std::thread worker;
+	std::atomic<bool> stopping{ false };
+	// the folder of the file being removed is waited for by cancel
+	std::atomic<bool> hurried{ false };
+
+	void run();
+	void remove(const std::filesystem::path& path);
+	void pause(uintmax_t bytes);
+	bool push(Job job);
+
+public:
+	// returns false when the queue is full
+	bool enqueue(const std::filesystem::path& path);
+	// the media store is cleaned after the files queued before
+	void enqueueCollect();
+	// forgets the queued files of the folder and waits for the file being removed from it
+	void cancel(const std::string& folder);
+	~TvJanitor();
+};
+
+extern TvJanitor tvJanitor;
+
+#endif
@@ -1,12 +1,20 @@
 #include "http-server.hpp"
 #include "show-screen.hpp"
+#include "test.hpp"
 #include <thread>
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    // tvport benchmark-picture <file.jpg> [rounds]
+    if (argc > 2 && std::string(argv[1]) == "benchmark-picture") {
+        return benchmarkPictureDecoding(argv[2], argc > 3 ? atoi(argv[3]) : 10);
+    }
+    // tvport check
+    if (argc > 1 && std::string(argv[1]) == "check") {
+        return runChecks();
+    }
     std::thread video_thread(showScreen);
     HttpServerInstance::runWithSelfTest();
     video_thread.join();
     return 0;
 }
-
@@ -0,0 +1,134 @@
+/*************************************************************
+TvMediaStore keeps one copy of every uploaded media file in the directory "store", next to the slot directories.
+The name of a file contains its check sum and length, so the name is the key of the content:
+a file of a new config which is already in the store is linked into the slot at once and is not uploaded again.
+Only the files with a check sum (not 0) are kept, the name of a file without it does not identify its content.
+
+The slots and the store share the files by hard links, so a file costs its disk space only once,
+the number of links is the number of references. A file system without hard links gets copies instead.
+takeUnreferenced moves the files of the store which are not referenced by any slot to the folder store/removed,
+the janitor (janitor.hpp) removes them from there after the slots are cleaned.
+storeMutex is held while a file is linked or copied into a slot and while the unreferenced files are taken,
+so a file is never taken out of the store between the check of its links and a new link to it,
+and the janitor never truncates a file which is being linked. The slow removal runs without the lock.
+**************************************************************/
+
+#ifndef TVPORT_MEDIA_STORE_HPP
+#define TVPORT_MEDIA_STORE_HPP
+
+#include "parameters.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#define TVPORT_MEDIA_STORE_FOLDER "store"
+#define TVPORT_MEDIA_STORE_REMOVED_FOLDER "store/removed"
+
+class TvMediaStore
+{
+	inline static std::mutex storeMutex;
+
+	static std::string getStoreFileName(const std::string& name)
+	{
+		return std::string(TVPORT_MEDIA_STORE_FOLDER) + "/" + name;
+	}
+
+	// hard link, or a copy when the file system cannot link
+	static bool share(const std::string& source, const std::string& target)
+	{
+		std::error_code ec;
+		std::filesystem::create_hard_link(source, target, ec);
+		if (ec)
+		{
+			ec.clear();
+			std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing, ec);
+		}
+		return !ec;
+	}
+
+	static bool isReferenced(const std::filesystem::path& storeFile)
+	{
+		std::error_code ec;
+		if (std::filesystem::hard_link_count(storeFile, ec) > 1 && !ec)
+		{
+			return true;
+		}
+		// the copies are looked for in the slots
+		for (int slot = TVPORT_MINIMUM_SLOT_NUMBER; slot <= TVPORT_MAXIMUM_SLOT_NUMBER; slot++)
+		{
+			if (std::filesystem::exists(std::filesystem::path(std::to_string(slot)) / storeFile.filename(), ec))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+public:
+	// makes the file of the store available in the slot, false when the store does not have it
+	static bool fetch(const std::string& name, const std::string& slotFileName, long long size)
+	{
+		std::string storeName = getStoreFileName(name);
+		std::lock_guard<std::mutex> lock(storeMutex);
+		std::error_code ec;
+		if (!std::filesystem::exists(storeName, ec) || std::filesystem::file_size(storeName, ec) != (uintmax_t)size || ec)
+		{
+			return false;
+		}
+		return share(storeName, slotFileName);
+	}
+
+	// the file is complete and checked, the store takes it
+	static void publish(const std::string& name, const std::string& slotFileName)
+	{
+		std::string storeName = getStoreFileName(name);
+		std::lock_guard<std::mutex> lock(storeMutex);
+		std::error_code ec;
+		if (std::filesystem::exists(storeName, ec))
+		{
+			return;
+		}
+		std::filesystem::create_directory(TVPORT_MEDIA_STORE_FOLDER, ec);
+		if (!share(slotFileName, storeName))
+		{
+			std::cout << "File " << name << " cannot be kept in the store" << std::endl;
+		}
+	}
+
+	// the files which no slot refers to, taken out of the store, and the files taken before and not removed yet
+	static std::vector<std::filesystem::path> takeUnreferenced()
+	{
+		std::vector<std::filesystem::path> unreferenced;
+		std::filesystem::path removedFolder(TVPORT_MEDIA_STORE_REMOVED_FOLDER);
+		std::lock_guard<std::mutex> lock(storeMutex);
+		std::error_code ec;
+		std::filesystem::create_directory(removedFolder, ec);
+		for (const auto& entry : std::filesystem::directory_iterator(TVPORT_MEDIA_STORE_FOLDER, ec))
+		{
+			if (entry.is_regular_file() && !isReferenced(entry.path()))
+			{
+				std::filesystem::path removed = removedFolder / entry.path().filename();
+				std::error_code renameError;
+				std::filesystem::rename(entry.path(), removed, renameError);
+				if (!renameError)
+				{
+					unreferenced.push_back(removed);
+				}
+			}
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(removedFolder, ec))
+		{
+			if (entry.is_regular_file() && std::find(unreferenced.begin(), unreferenced.end(), entry.path()) == unreferenced.end())
+			{
+				unreferenced.push_back(entry.path());
+			}
+		}
+		return unreferenced;
+	}
+};
+
+#endif
@@ -4,7 +4,26 @@
 #define TVPORT_DEFAULT_PORT_NUMBER 80
 #define PREEXISTING_SLOT_NUMBER 0
 #define TVPORT_MINIMUM_SLOT_NUMBER 1
-#define TVPORT_MAXIMUM_SLOT_NUMBER 2
+// the highest slot folder of the ring, slot_count.txt chooses how many of them are used
+#define TVPORT_MAXIMUM_SLOT_NUMBER 16
+// the shown slot and the uploaded one, the further slots keep the playlists staged for later
+#define TVPORT_DEFAULT_SLOT_COUNT 2
+// in megabytes, memory budget for the decoded and scaled pictures of the current slot
+#define TVPORT_DEFAULT_PICTURE_CACHE_MB 256
+// in megabytes, memory budget for the decoded and scaled frames of the short videos of the current slot
+#define TVPORT_DEFAULT_VIDEO_CACHE_MB 1024
+// in seconds, videos up to this length are kept as raw frames
+#define TVPORT_DEFAULT_RAW_CLIP_SECONDS 15
+// in megabytes, disk budget for all raw clips
+#define TVPORT_DEFAULT_RAW_CLIP_BUDGET_MB 2048
+// in megabytes per second, the janitor does not delete faster, so the slow storage keeps serving the screen
+#define TVPORT_DEFAULT_JANITOR_MB_PER_SECOND 64
+// the threads of the http server which read and write the sockets
+#define TVPORT_DEFAULT_HTTP_THREADS 4
+// the threads which run the http handlers touching the disk
+#define TVPORT_DEFAULT_HTTP_WORKERS 2
+// the handlers waiting for a worker, further requests are answered with 503
+#define TVPORT_DEFAULT_HTTP_QUEUE 64
 class ParamUtils {
     inline static const char* parameterSlotFileName = "slot.txt";
     inline static const char* parameterPortFileName = "port_number.txt";
@@ -12,6 +31,15 @@ class ParamUtils {
     inline static const char* parameterPaddingTopFileName = "padding_top.txt";
     inline static const char* parameterPaddingRightFileName = "padding_right.txt";
     inline static const char* parameterPaddingBottomFileName = "padding_bottom.txt";
+    inline static const char* parameterPictureCacheFileName = "picture_cache_mb.txt";
+    inline static const char* parameterBackgroundColorFileName = "background_color.txt";
+    inline static const char* parameterNoUpscaleFileName = "no_upscale.txt";
+    inline static const char* parameterVideoCacheFileName = "video_cache_mb.txt";
+    inline static const char* parameterRawClipSecondsFileName = "raw_clip_seconds.txt";
+    inline static const char* parameterRawClipBudgetFileName = "raw_clip_budget_mb.txt";
+    inline static const char* parameterJanitorRateFileName = "janitor_mb_per_second.txt";
+    inline static const char* parameterSlotCountFileName = "slot_count.txt";
+    inline static const char* parameterPlaylistIdFileName = "playlist_id.txt";
 
 public:
 
@@ -86,6 +114,11 @@ public:
     }
 
 
+    static const char* getParameterSlotFileName()
+    {
+        return parameterSlotFileName;
+    }
+
     static void writeParameterSlot(int slot)
     {
         writeParameterInteger((char*)parameterSlotFileName, slot);
@@ -164,6 +197,70 @@ public:
         return readWriteParameter((char*)parameterPaddingRightFileName, -1000, 0);
     }
 
+    static void writeParameterBackgroundColor(int color)
+    {
+        writeParameterInteger((char*)parameterBackgroundColorFileName, color);
+    }
+
+    // the color is kept as the number 0xRRGGBB
+    static int readParameterBackgroundColor()
+    {
+        return readWriteParameter((char*)parameterBackgroundColorFileName, -1, 0);
+    }
+
+    static void writeParameterNoUpscale(int noUpscale)
+    {
+        writeParameterInteger((char*)parameterNoUpscaleFileName, noUpscale);
+    }
+
+    // 1 means small pictures and videos are not extended to the screen
+    static int readParameterNoUpscale()
+    {
+        return readWriteParameter((char*)parameterNoUpscaleFileName, -1, 0);
+    }
+
+    static int readParameterVideoCacheMb()
+    {
+        return readWriteParameter((char*)parameterVideoCacheFileName, -1, TVPORT_DEFAULT_VIDEO_CACHE_MB);
+    }
+
+    // 0 means no raw clips are made
+    static int readParameterRawClipSeconds()
+    {
+        return readWriteParameter((char*)parameterRawClipSecondsFileName, -1, TVPORT_DEFAULT_RAW_CLIP_SECONDS);
+    }
+
+    static int readParameterRawClipBudgetMb()
+    {
+        return readWriteParameter((char*)parameterRawClipBudgetFileName, -1, TVPORT_DEFAULT_RAW_CLIP_BUDGET_MB);
+    }
+
+    static int readParameterPictureCacheMb()
+    {
+        return readWriteParameter((char*)parameterPictureCacheFileName, -1, TVPORT_DEFAULT_PICTURE_CACHE_MB);
+    }
+
+    // 0 means no limit
+    static int readParameterJanitorMbPerSecond()
+    {
+        return readWriteParameter((char*)parameterJanitorRateFileName, -1, TVPORT_DEFAULT_JANITOR_MB_PER_SECOND);
+    }
+
+    // the slots from TVPORT_MINIMUM_SLOT_NUMBER to this one are used, at least 2
+    static int readParameterSlotCount()
+    {
+        int res = readWriteParameter((char*)parameterSlotCountFileName, 1, TVPORT_DEFAULT_SLOT_COUNT);
+        return res > TVPORT_MAXIMUM_SLOT_NUMBER ? TVPORT_MAXIMUM_SLOT_NUMBER : res;
+    }
+
+    // every config gets the next playlist id, the ids are not used again
+    static int takeParameterPlaylistId()
+    {
+        int res = readParameterInteger((char*)parameterPlaylistIdFileName, 0) + 1;
+        writeParameterInteger((char*)parameterPlaylistIdFileName, res);
+        return res;
+    }
+
 };
 
 
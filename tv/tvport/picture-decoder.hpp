@@ -0,0 +1,97 @@
+/*************************************************************
+TvPictureDecoder decodes the pictures of the slot not bigger than needed for the screen.
+Big camera pictures (6000x4000 and more) are decoded by libjpeg directly at 1/2, 1/4 or 1/8 of their size
+(IMREAD_REDUCED_COLOR_2/4/8), which is several times faster and needs several times less memory than
+decoding the whole picture and resizing it afterwards.
+The size of the picture is read from the JPEG header first, the largest reduction is taken
+which still covers the content box, so the final resize only makes a small correction.
+The pictures may be rotated by their EXIF orientation, so the reduction must cover the box in both orientations.
+Other formats are decoded as before, the reduction brings nothing for them.
+**************************************************************/
+
+#ifndef TVPORT_PICTURE_DECODER_HPP
+#define TVPORT_PICTURE_DECODER_HPP
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "screen-layout.hpp"
+#include <fstream>
+#include <string>
+
+class TvPictureDecoder
+{
+public:
+	// reads the size from the SOF marker of a JPEG file, returns false for other files
+	static bool readJpegSize(const std::string& imagePath, int& width, int& height)
+	{
+		std::ifstream ifs(imagePath, std::ios::in | std::ios::binary);
+		unsigned char buffer[9];
+		if (!ifs.read((char*)buffer, 2) || buffer[0] != 0xFF || buffer[1] != 0xD8)
+		{
+			return false;
+		}
+		while (ifs.read((char*)buffer, 4))
+		{
+			if (buffer[0] != 0xFF)
+			{
+				return false;
+			}
+			unsigned char marker = buffer[1];
+			int length = (buffer[2] << 8) | buffer[3];
+			// SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+			if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+			{
+				if (!ifs.read((char*)buffer, 5))
+				{
+					return false;
+				}
+				height = (buffer[1] << 8) | buffer[2];
+				width = (buffer[3] << 8) | buffer[4];
+				return width > 0 && height > 0;
+			}
+			if (length < 2 || marker == 0xDA)
+			{
+				return false;
+			}
+			ifs.seekg(length - 2, std::ios::cur);
+		}
+		return false;
+	}
+
+	// IMREAD_COLOR or the largest IMREAD_REDUCED_COLOR_N which still covers the content box
+	static int chooseReadMode(int width, int height)
+	{
+		float factor = TvScreenLayout::calculateScaleToResize(width, height, 0.01);
+		float rotatedFactor = TvScreenLayout::calculateScaleToResize(height, width, 0.01);
+		if (factor <= 0.0001 || rotatedFactor <= 0.0001)
+		{
+			return cv::IMREAD_COLOR;
+		}
+		if (rotatedFactor > factor)
+		{
+			factor = rotatedFactor;
+		}
+		if (factor * 8 <= 1.0)
+		{
+			return cv::IMREAD_REDUCED_COLOR_8;
+		}
+		if (factor * 4 <= 1.0)
+		{
+			return cv::IMREAD_REDUCED_COLOR_4;
+		}
+		if (factor * 2 <= 1.0)
+		{
+			return cv::IMREAD_REDUCED_COLOR_2;
+		}
+		return cv::IMREAD_COLOR;
+	}
+
+	static cv::Mat decode(const std::string& imagePath)
+	{
+		int width, height;
+		int mode = readJpegSize(imagePath, width, height) ? chooseReadMode(width, height) : cv::IMREAD_COLOR;
+		return cv::imread(imagePath, mode);
+	}
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*************************************************************
+TvPrefetcher prepares the next item of the playlist on a worker thread while the current item is shown.
+For pictures it means the decoded and scaled image, for videos the opened VideoCapture
+(or the mapped raw clip, or the frames kept in memory) together with the first frame, which is already scaled.
+The render thread requests the next item before it starts to show the current one,
+and takes the prepared item when its turn comes, so the transition has no gap for imread or opening the video.
+If the requested item is still being prepared, take waits for it instead of doing the same work twice.
+An item is the same only with the same file, slot, slot generation and screen geometry (size, paddings, upscaling),
+a different item (the slot was switched, or the paddings have changed, for example) is dropped, take returns false
+and the caller prepares the item itself.
+When a new slot is ready, its first item is requested the same way while the old item is still shown,
+and the screen switches when isReady reports it, so the new slot starts with a prepared frame.
+**************************************************************/
+
+#ifndef TVPORT_PREFETCH_HPP
+#define TVPORT_PREFETCH_HPP
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+#include "raw-clip.hpp"
+#include "frame-cache.hpp"
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct TvPreparedItem {
+	std::string fileName;
+	bool isVideo = false;
+	int slotNumber = 0;
+	int slotGeneration = 0;
+	std::string geometry;
+	// scaled picture or the first scaled frame of the video
+	cv::Mat frame;
+	std::shared_ptr<cv::VideoCapture> video;
+	// the short video kept as raw frames, it is played instead of the video
+	std::shared_ptr<TvRawClip> rawClip;
+	// all frames of the short video, decoded during one of the previous loops
+	std::shared_ptr<TvDecodedVideo> decodedVideo;
+	// in ms, presentation time of the first frame of the video
+	double timestamp = 0;
+	float resizeFactor = 0;
+};
+
+class TvPrefetcher
+{
+	std::function<void(TvPreparedItem&)> prepare;
+	std::mutex prefetchMutex;
+	std::condition_variable prefetchCondition;
+	TvPreparedItem pending, ready;
+	bool hasPending = false, isPreparing = false, hasReady = false, stopping = false;
+	std::thread worker;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(prefetchMutex);
+		while (true)
+		{
+			prefetchCondition.wait(lock, [this] { return stopping || hasPending; });
+			if (stopping)
+			{
+				break;
+			}
+			TvPreparedItem item = pending;
+			hasPending = false;
+			isPreparing = true;
+			lock.unlock();
+			try {
+				prepare(item);
+			}
+			catch (const std::exception& e)
+			{
+				std::cout << "Prefetch of " << item.fileName << " failed: " << e.what() << std::endl;
+			}
+			lock.lock();
+			isPreparing = false;
+			if (!hasPending)
+			{
+				ready = item;
+				hasReady = true;
+			}
+			prefetchCondition.notify_all();
+		}
+	}
+
+	static bool isSameItem(const TvPreparedItem& a, const TvPreparedItem& b)
+	{
+		return a.fileName == b.fileName && a.slotNumber == b.slotNumber && a.slotGeneration == b.slotGeneration && a.geometry == b.geometry;
+	}
+
+	bool isWanted(const TvPreparedItem& item)
+	{
+		return (hasPending || isPreparing) && isSameItem(pending, item);
+	}
+
+public:
+	TvPrefetcher(std::function<void(TvPreparedItem&)> prepareItem)
+	{
+		prepare = prepareItem;
+		worker = std::thread(&TvPrefetcher::run, this);
+	}
+
+	// the item must have fileName, isVideo, slotNumber, slotGeneration and geometry filled in
+	void request(const TvPreparedItem& item)
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		pending = item;
+		hasPending = true;
+		hasReady = false;
+		ready = TvPreparedItem();
+		prefetchCondition.notify_all();
+	}
+
+	// item has the same fields as for request, it gets the prepared item, a stale prepared item is dropped
+	bool take(TvPreparedItem& item)
+	{
+		std::unique_lock<std::mutex> lock(prefetchMutex);
+		prefetchCondition.wait(lock, [this, &item] { return !isWanted(item); });
+		if (!hasReady)
+		{
+			return false;
+		}
+		bool same = isSameItem(ready, item);
+		if (same)
+		{
+			item = ready;
+		}
+		ready = TvPreparedItem();
+		hasReady = false;
+		return same;
+	}
+
+	// the item is prepared, take returns it at once
+	bool isReady(const TvPreparedItem& item)
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		return hasReady && isSameItem(ready, item);
+	}
+
+	// forgets the requested and the prepared items, it releases the opened video files too
+	void cancel()
+	{
+		std::unique_lock<std::mutex> lock(prefetchMutex);
+		hasPending = false;
+		prefetchCondition.wait(lock, [this] { return !isPreparing; });
+		hasReady = false;
+		ready = TvPreparedItem();
+	}
+
+	~TvPrefetcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(prefetchMutex);
+			stopping = true;
+			prefetchCondition.notify_all();
+		}
+		worker.join();
+	}
+};
+
+#endif
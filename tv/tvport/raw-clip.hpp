@@ -0,0 +1,158 @@
+/*************************************************************
+Raw clip is the file of already decoded and scaled BGR frames of a short video, which loops all day.
+It is written once by the ingest worker, when the slot becomes ready, and played by mapping the file into memory,
+every frame is a cv::Mat header over the mapped memory, so looping the clip costs no decoding and no copying.
+
+The format is as follows
+  header (TvRawClipHeader), the frames start at framesOffset (aligned to 4096)
+  frames, every frame has frameBytes bytes (height rows of width * 3 bytes)
+  index at indexOffset: the timestamp (double, in ms) of every frame
+The header is written again at the end, when the number of frames and the place of the index are known.
+
+The ingest worker makes raw clips only for videos shorter than raw_clip_seconds.txt
+and as long as all raw clips fit into raw_clip_budget_mb.txt
+**************************************************************/
+
+#ifndef TVPORT_RAW_CLIP_HPP
+#define TVPORT_RAW_CLIP_HPP
+
+#include "opencv2/core.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define TVPORT_RAW_CLIP_MAGIC "TVRAWCL1"
+#define TVPORT_RAW_CLIP_FRAMES_OFFSET 4096
+
+struct TvRawClipHeader {
+	char magic[8];
+	uint32_t width;
+	uint32_t height;
+	uint32_t type;
+	uint32_t frameCount;
+	uint64_t frameBytes;
+	uint64_t framesOffset;
+	uint64_t indexOffset;
+	double fps;
+};
+
+class TvRawClip
+{
+	boost::interprocess::file_mapping mapping;
+	boost::interprocess::mapped_region region;
+	TvRawClipHeader header{};
+	const char* base = nullptr;
+	const double* timestamps = nullptr;
+
+public:
+	// returns false when the file is missing, unfinished or corrupted
+	bool open(const std::string& fileName)
+	{
+		try {
+			mapping = boost::interprocess::file_mapping(fileName.c_str(), boost::interprocess::read_only);
+			region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+		size_t size = region.get_size();
+		base = static_cast<const char*>(region.get_address());
+		if (size < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, base, sizeof(header));
+		if (memcmp(header.magic, TVPORT_RAW_CLIP_MAGIC, sizeof(header.magic)) != 0 || header.frameCount == 0
+			|| header.frameBytes != (uint64_t)header.width * header.height * CV_ELEM_SIZE(header.type)
+			|| header.framesOffset + header.frameBytes * header.frameCount > header.indexOffset
+			|| header.indexOffset + sizeof(double) * header.frameCount > size)
+		{
+			return false;
+		}
+		timestamps = reinterpret_cast<const double*>(base + header.indexOffset);
+		return true;
+	}
+
+	int getFrameCount()
+	{
+		return (int)header.frameCount;
+	}
+
+	double getFps()
+	{
+		return header.fps;
+	}
+
+	// in ms
+	double getTimestamp(int pos)
+	{
+		return timestamps[pos];
+	}
+
+	// no copy: the Mat points into the mapped file, it must not be written to
+	cv::Mat getFrame(int pos)
+	{
+		return cv::Mat((int)header.height, (int)header.width, (int)header.type, const_cast<char*>(base + header.framesOffset + header.frameBytes * pos));
+	}
+};
+
+class TvRawClipWriter
+{
+	std::ofstream out;
+	TvRawClipHeader header{};
+	std::vector<double> timestamps;
+
+public:
+	bool open(const std::string& fileName, cv::Size size, int type, double fps)
+	{
+		out.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			return false;
+		}
+		memcpy(header.magic, TVPORT_RAW_CLIP_MAGIC, sizeof(header.magic));
+		header.width = size.width;
+		header.height = size.height;
+		header.type = type;
+		header.frameBytes = (uint64_t)size.width * size.height * CV_ELEM_SIZE(type);
+		header.framesOffset = TVPORT_RAW_CLIP_FRAMES_OFFSET;
+		header.fps = fps;
+		// the header is not valid until close writes it again
+		std::vector<char> empty(TVPORT_RAW_CLIP_FRAMES_OFFSET, 0);
+		out.write(empty.data(), empty.size());
+		return out.good();
+	}
+
+	bool write(const cv::Mat& frame, double timestamp)
+	{
+		if (frame.cols != (int)header.width || frame.rows != (int)header.height || frame.type() != (int)header.type)
+		{
+			return false;
+		}
+		size_t rowBytes = frame.cols * frame.elemSize();
+		for (int row = 0; row < frame.rows; row++)
+		{
+			out.write(frame.ptr<char>(row), rowBytes);
+		}
+		timestamps.push_back(timestamp);
+		header.frameCount++;
+		return out.good();
+	}
+
+	bool close()
+	{
+		header.indexOffset = header.framesOffset + header.frameBytes * header.frameCount;
+		out.write(reinterpret_cast<const char*>(timestamps.data()), sizeof(double) * timestamps.size());
+		out.seekp(0, std::ios::beg);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.close();
+		return !out.fail() && header.frameCount > 0;
+	}
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*************************************************************
+TvScreenLayout calculates where the pictures and videos go on the screen:
+the content box is the desktop without the paddings, and the scale factor makes the frame cover the content box.
+It is used by the render thread, the prefetch thread and the ingest worker, so it must not keep any state.
+**************************************************************/
+
+#ifndef TVPORT_SCREEN_LAYOUT_HPP
+#define TVPORT_SCREEN_LAYOUT_HPP
+
+#include <iostream>
+#include <string>
+
+#include "config-store.hpp"
+#include "window-related.hpp"
+
+class TvScreenLayout
+{
+public:
+	// returns 0 when the frame must be shown as it is
+	static float calculateScaleToResize(int width, int height, float reducableThreshold) {
+		if (height == 0 || width == 0) {
+			return 0.0;
+		}
+		int horizontal, vertical;
+		WindowRelatedUtils::getDesktopResolution(horizontal, vertical);
+		std::shared_ptr<const TvConfig> config = tvConfigStore.get();
+		int paddingTop = config->paddingTop;
+		int paddingLeft = config->paddingLeft;
+		int paddingRight = config->paddingRight;
+		int paddingBottom = config->paddingBottom;
+		bool noUpscale = config->noUpscale > 0;
+		horizontal -= paddingLeft + paddingRight;
+		vertical -= paddingTop + paddingBottom;
+		float riseVertical = ((float)vertical) / ((float)height);
+		float riseHorizontal = ((float)horizontal) / ((float)width);
+		float riseOptimal = riseHorizontal > riseVertical ? riseHorizontal : riseVertical;
+		std::cout << "horizontal=" << horizontal << " vertical=" << vertical << " padding=" << paddingTop << "," << paddingRight << "," << paddingBottom << "," << paddingLeft << " riseOptimal=" << riseOptimal << " v=" << riseVertical << " h=" << riseHorizontal << std::endl;
+		if (noUpscale && width <= horizontal && height <= vertical) {
+			// a small picture or video is shown as it is, the compositor fills the rest with the background color
+			return 0.0;
+		}
+		if (width >= horizontal) {
+			if (height >= vertical) {
+				if (reducableThreshold < 0.0 || riseOptimal + reducableThreshold>1.0) {
+					return 0.0;
+				}
+				return riseOptimal;
+			}
+			return riseVertical;
+		}
+		if (height >= vertical) {
+			return riseHorizontal;
+		}
+		return riseOptimal;
+	}
+
+	// everything the scale factor depends on, the scaled frames are kept by it
+	static std::string getScreenGeometry()
+	{
+		int horizontal, vertical;
+		WindowRelatedUtils::getDesktopResolution(horizontal, vertical);
+		std::shared_ptr<const TvConfig> config = tvConfigStore.get();
+		return std::to_string(horizontal) + "x" + std::to_string(vertical) + ":" + config->getAllPaddings() + ":" + std::to_string(config->noUpscale);
+	}
+
+	// the same for the file names: the size of the content box and the upscaling flag
+	static std::string getScaleTag()
+	{
+		int horizontal, vertical;
+		WindowRelatedUtils::getDesktopResolution(horizontal, vertical);
+		std::shared_ptr<const TvConfig> config = tvConfigStore.get();
+		horizontal -= config->paddingLeft + config->paddingRight;
+		vertical -= config->paddingTop + config->paddingBottom;
+		return std::to_string(horizontal) + "x" + std::to_string(vertical) + "u" + std::to_string(config->noUpscale);
+	}
+};
+
+#endif
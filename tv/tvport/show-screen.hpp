@@ -2,7 +2,16 @@
 #define TVPORT_SHOW_SCREEN_HPP
 
 #include "slots.hpp"
+#include "hot-reload.hpp"
 #include "window-related.hpp"
+#include "screen-layout.hpp"
+#include "frame-cache.hpp"
+#include "prefetch.hpp"
+#include "frame-ring.hpp"
+#include "video-clock.hpp"
+#include "frame-pool.hpp"
+#include "compositor.hpp"
+#include "picture-decoder.hpp"
 #include "opencv2/core.hpp"
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/highgui.hpp"
@@ -11,26 +20,22 @@
 #include <iostream>
 #include <vector>
 
-// in ms, this constant defines our reaction to new events
+// in ms, the longest time between the window events while a picture is shown, a new slot wakes the screen at once
 #define PICTURE_FRAME_DURATION 100
-// PICTURE_FRAME_FREQUENCY = 1000 / PICTURE_FRAME_DURATION
-#define PICTURE_FRAME_FREQUENCY 10
-// in ms, this constant defines our reaction to new events
+// in ms, this constant defines our reaction to new events, when no video frame is due earlier
 #define VIDEO_FRAME_DURATION 8
 // VIDEO_FRAME_FREQUENCY = 1000 / VIDEO_FRAME_DURATION
 #define VIDEO_FRAME_FREQUENCY 125
 // in ms, this constant defines our reaction to new events
 #define VIDEO_ERROR_LIMIT 50
 #define VIDEO_ERROR_TOTAL_LIMIT 5000
+// in frames, the decode thread skips a frame which is late more than this
+#define VIDEO_SKIP_DECODING_LATENESS 2
 #define IDLE_FRAME_DURATION 50
 // number of idle frames
 #define IDLE_FRAME_AMOUNT 4
 #define SCREEN_ESCAPE_KEY 27
 
-#define VIDEO_RESIZE_UNKNOWN 0
-#define VIDEO_RESIZE_REQUIRED 1
-#define VIDEO_RESIZE_NON_REQUIRED 2
-
 using namespace std;
 using namespace cv;
 
@@ -44,7 +49,20 @@ protected:
   int currentSlotNumber = 0;
   int currentScreenNumber = 0, totalScreenNumber=0;
   bool screenRunning = true;
-  
+  bool pictureCacheFilled = false;
+  // the generation of the ready slot, whose first item is requested from the prefetcher
+  int warmGeneration = 0;
+  // taken once per pass of the playlist, the http server may replace the slots meanwhile
+  shared_ptr<const TvPortSlotSnapshot> playlist = tvPortSlots.getSnapshot();
+  string screenGeometry;
+  // the parameters the screen is set up with, the store publishes new ones when they change
+  shared_ptr<const TvConfig> appliedConfig;
+  TvFramePool framePool;
+  TvCompositor compositor;
+  TvFrameCache pictureCache{ (size_t)tvConfigStore.get()->pictureCacheMb * 1024 * 1024 };
+  TvVideoFrameCache videoFrameCache{ (size_t)tvConfigStore.get()->videoCacheMb * 1024 * 1024 };
+  // declared after the cache, so the prefetch thread stops before the cache is destroyed
+  TvPrefetcher prefetcher{ [this](TvPreparedItem& item) { prepareItem(item); } };
   
 
   void setupScreen() 
@@ -54,143 +72,482 @@ protected:
     WindowRelatedUtils::setFullScreenMode(windowName);
   }
 
-  float calculateScaleToResize(int width, int height, float reducableThreshold) {
-      if (height == 0 || width == 0) {
-          return 0.0;
-      }
+  void setupCompositor()
+  {
       int horizontal, vertical;
       WindowRelatedUtils::getDesktopResolution(horizontal, vertical);
-      int paddingTop = ParamUtils::readParameterPaddingTop();
-      int paddingLeft = ParamUtils::readParameterPaddingLeft();
-      int paddingRight = ParamUtils::readParameterPaddingRight();
-      int paddingBottom = ParamUtils::readParameterPaddingBottom();
-      horizontal -= paddingLeft + paddingRight;
-      vertical -= paddingTop + paddingBottom;
-      float riseVertical = ((float)vertical) / ((float)height);
-      float riseHorizontal = ((float)horizontal) / ((float)width);
-      float riseOptimal = riseHorizontal > riseVertical ? riseHorizontal : riseVertical;
-      cout << "horizontal=" << horizontal << " vertical=" << vertical << " padding=" << paddingTop << "," << paddingRight << "," << paddingBottom << "," << paddingLeft << " riseOptimal=" << riseOptimal << " v=" << riseVertical << " h=" << riseHorizontal << std::endl;
-      if (width >= horizontal) {
-          if (height >= vertical) {
-              if (reducableThreshold < 0.0 || riseOptimal + reducableThreshold>1.0) {
-                  return 0.0;
-              }
-              return riseOptimal;
-          }
-          return riseVertical;
-      }
-      if (height >= vertical) {
-          return riseHorizontal;
+      shared_ptr<const TvConfig> config = tvConfigStore.get();
+      compositor.configure(horizontal, vertical, config->paddingTop, config->paddingRight,
+          config->paddingBottom, config->paddingLeft, config->backgroundColor);
+  }
+
+  // called before every pass of the playlist and when the store has published new parameters before the next item
+  void applyConfig()
+  {
+      appliedConfig = tvConfigStore.get();
+      string geometry = TvScreenLayout::getScreenGeometry();
+      if (geometry != screenGeometry)
+      {
+          // the prepared items have the old size
+          prefetcher.cancel();
+          preparePictureCache();
       }
-      return riseOptimal;
+      setupCompositor();
   }
 
-  void taskShowPicture(string imagePath, int duration) 
+  void showFrame(const Mat& frame)
   {
-    duration *= PICTURE_FRAME_FREQUENCY;
-    Mat img = imread(imagePath, IMREAD_COLOR);
+      imshow(windowName, compositor.isConfigured() ? compositor.compose(frame) : frame);
+      tvPortSlots.reportFrameShown(currentSlotNumber);
+  }
 
-    if (img.empty()) // Check for failure
+  // the same size as resize(src, dst, Size(), factor, factor) produces
+  Size getScaledSize(Size size, float resizeFactor)
+  {
+      return Size(saturate_cast<int>(size.width * resizeFactor), saturate_cast<int>(size.height * resizeFactor));
+  }
+
+  Mat loadPicture(string imagePath)
+  {
+    Mat img = TvPictureDecoder::decode(imagePath);
+    if (img.empty())
     {
-        cout << "Could not open or find the image" << endl;
-        this_thread::sleep_for(200ms);
-        return;
+        return img;
     }
-    float resizeFactor = calculateScaleToResize(img.size().width, img.size().height, 0.01);
+    float resizeFactor = TvScreenLayout::calculateScaleToResize(img.size().width, img.size().height, 0.01);
     if (resizeFactor > 0.0001) {
-        Mat dst;
+        Mat dst = framePool.acquire(getScaledSize(img.size(), resizeFactor), img.type());
         cout << "Buildestorrelsesfaktor " << resizeFactor << std::endl;
-        resize(img, dst, Size(), resizeFactor, resizeFactor, INTER_CUBIC);
-        imshow(windowName, dst);
+        resize(img, dst, dst.size(), 0, 0, INTER_CUBIC);
+        return dst;
+    }
+    return img;
+  }
+
+  Mat getPicture(string imagePath, int slotNumber, string geometry)
+  {
+    Mat img;
+    if (pictureCache.find(imagePath, geometry, img))
+    {
+        return img;
+    }
+    img = loadPicture(imagePath);
+    pictureCache.insert(imagePath, geometry, slotNumber, img);
+    return img;
+  }
+
+  // called when the slot becomes current: drops the pictures of the old slot,
+  // the pictures of the new one are decoded when its first frame is on the screen (fillPictureCache)
+  void preparePictureCache()
+  {
+    screenGeometry = TvScreenLayout::getScreenGeometry();
+    pictureCache.retain(currentSlotNumber, screenGeometry);
+    framePool.trim();
+    playlist = tvPortSlots.getSnapshot();
+    pictureCacheFilled = false;
+  }
+
+  // decodes the pictures of the slot as long as the memory budget allows
+  void fillPictureCache()
+  {
+    if (pictureCacheFilled)
+    {
+        return;
+    }
+    pictureCacheFilled = true;
+    int n = playlist->getScreenNumber();
+    for (int i = 0; i < n && !pictureCache.isFull(); i++)
+    {
+        if (!playlist->isVideo(i))
+        {
+            getPicture(playlist->getFileName(i), currentSlotNumber, screenGeometry);
+        }
+    }
+    cout << "Picture cache of slot " << currentSlotNumber << " uses " << pictureCache.getUsedBytes() << " bytes" << std::endl;
+  }
+
+  // runs on the prefetch thread or, if the item was not prefetched, on the render thread
+  void prepareItem(TvPreparedItem& item)
+  {
+    if (!item.isVideo)
+    {
+        item.frame = getPicture(item.fileName, item.slotNumber, item.geometry);
+        return;
+    }
+    // the frames kept in memory since the previous loop
+    item.decodedVideo = videoFrameCache.find(item.fileName, item.geometry, item.slotGeneration);
+    if (item.decodedVideo != nullptr)
+    {
+        item.frame = item.decodedVideo->frames.at(0);
+        item.timestamp = item.decodedVideo->timestamps.at(0);
+        return;
+    }
+    // the raw clip made by the ingest worker needs no decoding at all
+    string rawName = TvIngestWorker::getRawFileName(item.fileName);
+    if (filesystem::exists(rawName))
+    {
+        shared_ptr<TvRawClip> clip = make_shared<TvRawClip>();
+        if (clip->open(rawName))
+        {
+            item.rawClip = clip;
+            item.frame = clip->getFrame(0);
+            item.timestamp = clip->getTimestamp(0);
+            return;
+        }
+    }
+    // the video scaled to the screen by the ingest worker is played without resizing
+    string scaledName = TvIngestWorker::getScaledFileName(item.fileName);
+    bool isScaled = filesystem::exists(scaledName);
+    item.video = make_shared<VideoCapture>(isScaled ? scaledName : item.fileName);
+    Mat frame;
+    if (!item.video->isOpened() || !item.video->read(frame) || frame.empty())
+    {
+        return;
+    }
+    item.timestamp = item.video->get(CAP_PROP_POS_MSEC);
+    item.resizeFactor = isScaled ? 0 : TvScreenLayout::calculateScaleToResize(frame.size().width, frame.size().height, 0.05);
+    if (item.resizeFactor > 0.0001) {
+        std::cout << "Resizing video " << item.fileName << " (" << frame.size().width << "," << frame.size().height << ") by " << item.resizeFactor << std::endl;
+        item.frame = framePool.acquire(getScaledSize(frame.size(), item.resizeFactor), frame.type());
+        resize(frame, item.frame, item.frame.size(), 0, 0, INTER_CUBIC);
     }
     else {
-        imshow(windowName, img);
+        item.frame = frame;
+    }
+  }
+
+  TvPreparedItem makeItem(const TvPortSlotSnapshot& slot, int screen)
+  {
+    TvPreparedItem item;
+    item.fileName = slot.getFileName(screen);
+    item.isVideo = slot.isVideo(screen);
+    item.slotNumber = slot.slotNumber;
+    item.slotGeneration = slot.generation;
+    item.geometry = screenGeometry;
+    return item;
+  }
+
+  TvPreparedItem makeItem(int screen)
+  {
+    return makeItem(*playlist, screen);
+  }
+
+  // a new slot is ready: its first item is prepared by the prefetcher while the current item stays on the screen,
+  // returns true when the switch may happen
+  bool isSwitchWarm()
+  {
+    shared_ptr<const TvPortSlotSnapshot> ready = tvPortSlots.getReadySnapshot();
+    if (ready == nullptr || ready->getScreenNumber() == 0)
+    {
+        return true;
+    }
+    TvPreparedItem first = makeItem(*ready, 0);
+    if (warmGeneration != ready->generation)
+    {
+        warmGeneration = ready->generation;
+        prefetcher.request(first);
+    }
+    return prefetcher.isReady(first);
+  }
+
+  bool isSwitchDue()
+  {
+    return tvPortSlots.isRequiredToSwitch(currentSlotNumber) && isSwitchWarm();
+  }
+
+  void taskShowPicture(TvPreparedItem& item, int duration) 
+  {
+    Mat img = item.frame;
+
+    if (img.empty()) // Check for failure
+    {
+        cout << "Could not open or find the image" << endl;
+        this_thread::sleep_for(200ms);
+        return;
     }
+    showFrame(img);
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::seconds(duration);
+    fillPictureCache();
 
-    for(int i=0;i<duration;i++)
+    while (true)
     {
-        int k = waitKey(PICTURE_FRAME_DURATION);
+        int k = waitKey(1);
         if (k== SCREEN_ESCAPE_KEY)
         {
             screenRunning = false;
             break;
         }
-        if (tvPortSlots.isRequiredToSwitch(currentSlotNumber))
+        if (isSwitchDue())
+        {
+            break;
+        }
+        int remaining = (int)chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (remaining <= 0)
         {
             break;
         }
+        if (tvPortSlots.isRequiredToSwitch(currentSlotNumber))
+        {
+            // the first item of the new slot is still being prepared
+            this_thread::sleep_for(chrono::milliseconds(min(remaining, VIDEO_FRAME_DURATION)));
+        }
+        else {
+            tvPortSlots.waitForSwitch(currentSlotNumber, min(remaining, PICTURE_FRAME_DURATION));
+        }
     }
   }
 
-  void taskShowVideo(string fileName) 
+  // runs on the decode thread of the video: reads and scales the frames and pushes them into the ring
+  // together with their timestamps, the frames which are already late by the clock are skipped without decoding.
+  // A short video is recorded into the video frame cache at the same time, if it is played to the end without skipping
+  void decodeVideo(TvPreparedItem& item, TvFrameRing& ring, TvVideoClock& clock, atomic<bool>& stopDecoding)
   {
-      VideoCapture video(fileName);
-      Mat frame;
+      VideoCapture& video = *item.video;
       int errors = 0, totalErrors = 0;
-      int videoResize = VIDEO_RESIZE_UNKNOWN;
-      float resizeFactor = 0;
+      bool resizeRequired = item.resizeFactor > 0.0001;
+      // all buffers are taken from the pool, so the frames of the video do not allocate anything
+      Size sourceSize((int)video.get(CAP_PROP_FRAME_WIDTH), (int)video.get(CAP_PROP_FRAME_HEIGHT));
+      if (sourceSize.width <= 0 || sourceSize.height <= 0)
+      {
+          sourceSize = item.frame.size();
+      }
+      Size targetSize = resizeRequired ? getScaledSize(sourceSize, item.resizeFactor) : sourceSize;
+      Mat frame;
+      if (resizeRequired)
+      {
+          framePool.prepare(frame, sourceSize, item.frame.type());
+      }
+      double frameDuration = clock.getFrameDuration();
+      double timestamp = item.timestamp;
+      bool completed = false;
+      size_t frameBytes = targetSize.area() * item.frame.elemSize();
+      double frameCount = video.get(CAP_PROP_FRAME_COUNT);
+      shared_ptr<TvDecodedVideo> recording;
+      if (frameCount > 0 && frameCount * frameBytes <= videoFrameCache.getBudget())
+      {
+          recording = make_shared<TvDecodedVideo>();
+          recording->fps = 1000.0 / frameDuration;
+          recording->frames.push_back(item.frame.clone());
+          recording->timestamps.push_back(item.timestamp);
+          recording->bytes = frameBytes;
+      }
 
-      while (video.isOpened())
+      while (!stopDecoding.load() && video.isOpened())
       {
+          TvRingFrame* target = ring.waitWriteFrame();
+          if (target == nullptr)
+          {
+              break;
+          }
+          if (clock.getLateness(timestamp + frameDuration) > VIDEO_SKIP_DECODING_LATENESS * frameDuration)
+          {
+              if (!video.grab())
+              {
+                  break;
+              }
+              timestamp = getFrameTimestamp(video, timestamp, frameDuration);
+              clock.countSkipped();
+              recording = nullptr;
+              continue;
+          }
+          framePool.prepare(target->image, targetSize, item.frame.type());
+          // without resizing the frame is read straight into the buffer of the ring
+          Mat& decoded = resizeRequired ? frame : target->image;
           try {
-              if (!video.read(frame) || frame.empty())
+              if (!video.read(decoded) || decoded.empty())
               {
+                  completed = true;
                   break;
               }
               errors = 0;
-          } 
+          }
           catch (...)
           {
               errors++;
               totalErrors++;
-              if (errors >= VIDEO_ERROR_LIMIT || totalErrors>=VIDEO_ERROR_TOTAL_LIMIT)
+              if (errors >= VIDEO_ERROR_LIMIT || totalErrors >= VIDEO_ERROR_TOTAL_LIMIT)
               {
-                  std::cout << fileName << " Video is broken or has unsupported format" << std::endl;
+                  std::cout << item.fileName << " Video is broken or has unsupported format" << std::endl;
                   break;
               }
+              recording = nullptr;
+              continue;
+          }
+          if (resizeRequired) {
+              resize(frame, target->image, targetSize, 0, 0, INTER_CUBIC);
           }
-          if (videoResize == VIDEO_RESIZE_UNKNOWN)
+          timestamp = getFrameTimestamp(video, timestamp, frameDuration);
+          target->timestamp = timestamp;
+          if (recording != nullptr)
           {
-              resizeFactor = calculateScaleToResize(frame.size().width, frame.size().height, 0.05);
-              if (resizeFactor > 0.0001) {
-                  videoResize = VIDEO_RESIZE_REQUIRED;
-                  std::cout << "Resizing video " << fileName << " (" << frame.size().width  << "," << frame.size().height << ") by " <<  resizeFactor << std::endl;
+              if (recording->bytes + frameBytes > videoFrameCache.getBudget())
+              {
+                  recording = nullptr;
               }
               else {
-                  videoResize = VIDEO_RESIZE_NON_REQUIRED;
+                  recording->frames.push_back(target->image.clone());
+                  recording->timestamps.push_back(timestamp);
+                  recording->bytes += frameBytes;
               }
           }
-          if (videoResize == VIDEO_RESIZE_REQUIRED) {
-              Mat dst;
-              resize(frame, dst, Size(), resizeFactor, resizeFactor, INTER_CUBIC);
-              imshow(windowName, dst);
+          ring.push();
+      }
+      if (completed && recording != nullptr && videoFrameCache.insert(item.fileName, item.geometry, item.slotGeneration, recording))
+      {
+          std::cout << "Video " << item.fileName << " is kept in memory, " << recording->frames.size() << " frames, " << recording->bytes << " bytes" << std::endl;
+      }
+      ring.finish();
+  }
+
+  // some containers do not report the position, then the timestamps are counted by the frame rate
+  double getFrameTimestamp(VideoCapture& video, double previousTimestamp, double frameDuration)
+  {
+      double timestamp = video.get(CAP_PROP_POS_MSEC);
+      return timestamp > previousTimestamp ? timestamp : previousTimestamp + frameDuration;
+  }
+
+  // returns false when the video must be stopped
+  bool waitVideoEvents(int delay)
+  {
+      int k = waitKey(delay < 1 ? 1 : delay);
+      if (k == SCREEN_ESCAPE_KEY)
+      {
+          screenRunning = false;
+          return false;
+      }
+      return !isSwitchDue();
+  }
+
+  // the frames of the raw clip or of the video frame cache are ready already, they are only presented at their due time
+  void presentFrames(TvPreparedItem& item, double fps, int n, function<Mat(int)> getFrame, function<double(int)> getTimestamp)
+  {
+      TvVideoClock clock(fps);
+      showFrame(item.frame);
+      clock.start(item.timestamp);
+      clock.countPresented(0);
+      bool droppedPrevious = false;
+      int i = 1;
+      while (i < n)
+      {
+          double lateness = clock.getLateness(getTimestamp(i));
+          if (lateness < -1)
+          {
+              if (!waitVideoEvents((int)(-lateness < VIDEO_FRAME_DURATION ? -lateness : VIDEO_FRAME_DURATION)))
+              {
+                  break;
+              }
+              continue;
           }
-          else {
-              imshow(windowName, frame);
+          // a late frame is simply passed by, nothing was decoded for it,
+          // but never two in a row, so a slow screen still shows every second frame
+          if (lateness > clock.getFrameDuration() && i + 1 < n && !droppedPrevious)
+          {
+              clock.countSkipped();
+              droppedPrevious = true;
+              i++;
+              continue;
           }
-          int k = waitKey(VIDEO_FRAME_DURATION);
-          if (k == SCREEN_ESCAPE_KEY)
+          droppedPrevious = false;
+          showFrame(getFrame(i));
+          clock.countPresented(lateness);
+          i++;
+          if (!waitVideoEvents(1))
           {
-              screenRunning = false;
               break;
           }
-          if (tvPortSlots.isRequiredToSwitch(currentSlotNumber))
+      }
+      clock.printStatistics(item.fileName);
+  }
+
+  // the render thread only presents the frames at their due time, they are decoded and scaled on the decode thread
+  void taskShowVideo(TvPreparedItem& item) 
+  {
+      if (item.decodedVideo != nullptr)
+      {
+          TvDecodedVideo& decoded = *item.decodedVideo;
+          presentFrames(item, decoded.fps, (int)decoded.frames.size(), [&decoded](int i) { return decoded.frames.at(i); }, [&decoded](int i) { return decoded.timestamps.at(i); });
+          return;
+      }
+      if (item.rawClip != nullptr)
+      {
+          TvRawClip& clip = *item.rawClip;
+          presentFrames(item, clip.getFps(), clip.getFrameCount(), [&clip](int i) { return clip.getFrame(i); }, [&clip](int i) { return clip.getTimestamp(i); });
+          return;
+      }
+      if (item.video == nullptr || item.frame.empty())
+      {
+          std::cout << item.fileName << " Video cannot be opened" << std::endl;
+          return;
+      }
+      TvVideoClock clock(item.video->get(CAP_PROP_FPS));
+      double frameDuration = clock.getFrameDuration();
+      // the first frame is already read and scaled by prepareItem
+      showFrame(item.frame);
+      clock.start(item.timestamp);
+      clock.countPresented(0);
+      TvFrameRing ring;
+      atomic<bool> stopDecoding{ false };
+      bool droppedPrevious = false;
+      thread decoder(&TvShowScreen::decodeVideo, this, std::ref(item), std::ref(ring), std::ref(clock), std::ref(stopDecoding));
+
+      while (true)
+      {
+          TvRingFrame* frame = ring.getReadFrame();
+          if (frame == nullptr)
+          {
+              if (ring.isDrained() || !waitVideoEvents(1))
+              {
+                  break;
+              }
+              continue;
+          }
+          double lateness = clock.getLateness(frame->timestamp);
+          if (lateness < -1)
+          {
+              if (!waitVideoEvents((int)(-lateness < VIDEO_FRAME_DURATION ? -lateness : VIDEO_FRAME_DURATION)))
+              {
+                  break;
+              }
+              continue;
+          }
+          // never two drops in a row, so a slow screen still shows every second frame
+          if (lateness > frameDuration && !droppedPrevious)
+          {
+              ring.pop();
+              clock.countDropped();
+              droppedPrevious = true;
+              continue;
+          }
+          droppedPrevious = false;
+          showFrame(frame->image);
+          clock.countPresented(lateness);
+          ring.pop();
+          if (!waitVideoEvents(1))
           {
               break;
           }
       }
-      video.release();
+      stopDecoding = true;
+      ring.stop();
+      decoder.join();
+      item.video->release();
+      clock.printStatistics(item.fileName);
+      std::cout << framePool.getStatistics() << std::endl;
   }
 
   void taskIdle()
   {
     for(int i=0;i<IDLE_FRAME_AMOUNT;i++)
     {
-        int k = waitKey(IDLE_FRAME_DURATION);
+        int k = waitKey(1);
         if (k==27) 
         {
             screenRunning = false;
         }
+        if (tvPortSlots.waitForSwitch(currentSlotNumber, IDLE_FRAME_DURATION))
+        {
+            break;
+        }
     }
   }
 public:
@@ -199,26 +556,47 @@ public:
   {
     setupScreen();
     currentSlotNumber = tvPortSlots.loadInitialSlot();
+    tvHotReload.start();
+    preparePictureCache();
     while(screenRunning)
     {
-        totalScreenNumber = tvPortSlots.getCurrentSlotScreens();
+        applyConfig();
+        playlist = tvPortSlots.getSnapshot();
+        totalScreenNumber = playlist->getScreenNumber();
         if (totalScreenNumber > 0)
         {
             for (int i = 0; i < totalScreenNumber; i++)
             {
+                if (tvConfigStore.get() != appliedConfig)
+                {
+                    applyConfig();
+                }
                 WindowRelatedUtils::windowCleaning();
-                string filePath = tvPortSlots.getCurrentSlotFileName(i);
-                int duration = tvPortSlots.getCurrentSlotDuration(i);
+                string filePath = playlist->getFileName(i);
+                int duration = playlist->getDuration(i);
                 if (filePath.empty())
                 {
                     taskIdle();
                 }
-                else if (tvPortSlots.isCurrentSlotVideo(i))
-                {
-                    taskShowVideo(filePath);
-                }
                 else {
-                    taskShowPicture(filePath, duration);
+                    TvPreparedItem item = makeItem(i);
+                    if (!prefetcher.take(item))
+                    {
+                        prepareItem(item);
+                    }
+                    // the next item is prepared while this one is on the screen
+                    TvPreparedItem nextItem = makeItem((i + 1) % totalScreenNumber);
+                    if (!nextItem.fileName.empty())
+                    {
+                        prefetcher.request(nextItem);
+                    }
+                    if (item.isVideo)
+                    {
+                        taskShowVideo(item);
+                    }
+                    else {
+                        taskShowPicture(item, duration);
+                    }
                 }
                 if (!screenRunning || tvPortSlots.isRequiredToSwitch(currentSlotNumber))
                 {
@@ -232,6 +610,7 @@ public:
         if (screenRunning && tvPortSlots.isRequiredToSwitch(currentSlotNumber))
         {
             currentSlotNumber = tvPortSlots.switchToCurrentTask();
+            preparePictureCache();
         }
     }
   }
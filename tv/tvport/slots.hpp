@@ -11,19 +11,51 @@ Name of each file is as follows
   second letters: id= 0, 1, 2, ... for pictures
              file name without extension for video
   next letter: '_'
-  next digits: check sum
+  next digits: check sum, CRC-32C in decimal, 0 when the file is not checked.
+             It is verified only when the config has "checksum":"crc32c", the older masters send other numbers there,
+             their files are taken without a check and are not kept in the media store
   next letter: '-'
   next digits: file length
   next letters: .extension (.jpg, .mp4, .png, ...)
 
   information about absense is given in the format as follows:
-   {"fileName1":offset1, "fileName2":offset2}, where offset is the number of available bytes
+   {"fileName1":[[start1,end1],[start2,end2]], "fileName2":[[0,length2]]}, where every pair is a missing range of bytes
+   (end is exclusive)
+
+TvPortFileState keeps the upload state of every file in memory: the expected size and the arrived ranges.
+A chunk only updates this state, the whole slot is verified on the disk once, when the last file is complete.
+An incomplete file is kept as fileName.part, which is preallocated at the expected size on the first chunk,
+so the chunks may arrive in any order and over several connections, each of them is written at its own position.
+When the last range arrives, the check sum is verified and the .part file is renamed to the file name.
+A file with a wrong check sum is reported as missing again, so the master sends only this file again,
+after TVPORT_CHECKSUM_MAXIMUM_FAILURES failures of a file the slot is corrupted and waits for a new config.
+The checked files are kept in the media store (media-store.hpp) too, a file of a new config found there
+is linked into the slot and is not uploaded at all.
+Every slot but slot 0 keeps the journal of its uploads (upload-journal.hpp): the CRC-32C of its config, the arrived ranges with their sums,
+the completed files and the verified slot. At the start the journal is replayed instead of reading the files,
+when it belongs to the config on the disk, so the current slot is shown without looking at its files,
+and the next slot, whose upload was cut by a restart, continues with the ranges it already has.
+A slot without a valid journal is verified on the disk as before, and its journal starts again.
 
 TvPortSlot provide all functionality necessary for the current slot
 
 TvPortSlots manages the current slot for the show and next slot for uploading in parallel,
    also it manages the initial loading of the slot from the file system
 
+The slots form a ring of slot_count.txt folders (2 by default, up to TVPORT_MAXIMUM_SLOT_NUMBER).
+Every config gets a playlist id, a generation number which is never used again. A config sent by /config is shown
+as soon as it is ready, a config sent by /stage is kept ready in its slot, and /activate/<id> shows it later:
+the id is looked up in a hash map and the render thread switches to the prepared snapshot, nothing is uploaded at go-live time.
+The former current slot stays staged as well, so a playlist can be shown again. A new config takes a free slot of the ring,
+or the staged slot used the longest time ago. The staged slots are restored from their journals after a restart.
+
+TvPortSlotSnapshot is the playable copy of the current slot (files, durations, video flags), it is never changed after it is made.
+Every time the current slot is replaced, a new snapshot is published by an atomic shared pointer,
+so the render thread and the http server read the playlist without locks, and an old snapshot lives as long as somebody plays it.
+The snapshot of the next slot is made when the slot becomes ready, and the render thread is woken by a condition variable,
+it prepares the first item of that snapshot while the old item is still on the screen, and switches when the item is ready.
+The time from "slot ready" to the first shown frame of the new slot is measured and shown in /info.
+
 **************************************************************/
 
 
@@ -34,25 +66,49 @@ TvPortSlots manages the current slot for the show and next slot for uploading in
 #include <iostream> 
 #include <fstream>
 #include <vector> 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <map>
+#include <shared_mutex>
+#include <sstream>
 #include <string>
+#include <unordered_map>
 
 #include <boost/json.hpp>
 
 #include "parameters.hpp"
+#include "config-store.hpp"
+#include "ingest.hpp"
+#include "checksum.hpp"
+#include "media-store.hpp"
+#include "janitor.hpp"
+#include "upload-journal.hpp"
 
 namespace filesystem = std::filesystem;
 namespace json = boost::json;
 
+// the value of "checksum" in the config which turns the verification of the check sums in the file names on
+#define TVPORT_CHECKSUM_CRC32C "crc32c"
+// a file failing its check sum so many times is not requested again
+#define TVPORT_CHECKSUM_MAXIMUM_FAILURES 3
+
 struct TvPortConfiguration {
 	std::vector<std::string> file;
 	std::vector<int> duration;
+	// the kind of the check sums in the file names, empty when they are not checked
+	std::string checksum;
 
 	friend TvPortConfiguration tag_invoke(json::value_to_tag<TvPortConfiguration>, json::value const& v) {
 		auto& o = v.as_object();
+		auto checksum = o.if_contains("checksum");
 		return {
 			json::value_to<std::vector<std::string>>(o.at("file")),
 			json::value_to<std::vector<int>>(o.at("duration")),
+			checksum != nullptr && checksum->is_string() ? json::value_to<std::string>(*checksum) : std::string(),
 		};
 	}
 
@@ -65,6 +121,191 @@ struct TvPortConfiguration {
 			{"file", file},
 			{"duration", duration},
 		};
+		if (!rec.checksum.empty())
+		{
+			v.as_object()["checksum"] = rec.checksum;
+		}
+	}
+};
+
+struct TvPortFileState {
+	long long expectedSize = 0;
+	long long received = 0;
+	// the .part file has got its expected size
+	bool allocated = false;
+	// all bytes have arrived and are checked, but the .part file could not be renamed yet,
+	// e.g. a chunk sent again still has it open on Windows, the rename is tried again with the next chunk
+	bool renamePending = false;
+	// 0 when the file is not checked
+	uint32_t expectedChecksum = 0;
+	// the uploads of the file which failed the check sum, not cleared by reset
+	int checksumFailures = 0;
+	// the check sum of the first checksumSize bytes, -1 when it cannot be summed while uploading
+	uint32_t checksum = 0;
+	long long checksumSize = 0;
+	// the sums of the chunks which came after a gap, start -> (end, sum)
+	std::map<long long, std::pair<long long, uint32_t>> pendingChecksums;
+	// arrived ranges of the file, start -> end (exclusive), the touching ranges are merged
+	std::map<long long, long long> ranges;
+
+	void reset(long long size)
+	{
+		expectedSize = size;
+		received = 0;
+		allocated = false;
+		renamePending = false;
+		ranges.clear();
+		checksum = 0;
+		checksumSize = 0;
+		pendingChecksums.clear();
+	}
+
+	// joins the sum of the chunk to the sum of the file, the chunks after a gap wait until the gap is filled
+	void addChecksum(long long start, long long end, uint32_t chunkChecksum)
+	{
+		if (checksumSize < 0)
+		{
+			return;
+		}
+		if (start < checksumSize)
+		{
+			// a chunk sent again, the summed bytes may have changed
+			checksumSize = -1;
+			pendingChecksums.clear();
+			return;
+		}
+		pendingChecksums[start] = std::make_pair(end, chunkChecksum);
+		for (auto it = pendingChecksums.find(checksumSize); it != pendingChecksums.end(); it = pendingChecksums.find(checksumSize))
+		{
+			checksum = TvChecksum::combine(checksum, it->second.second, it->second.first - it->first);
+			checksumSize = it->second.first;
+			pendingChecksums.erase(it);
+		}
+	}
+
+	bool isComplete()
+	{
+		return expectedSize > 0 && received >= expectedSize;
+	}
+
+	// number of bytes available from the start of the file
+	long long getContiguousSize()
+	{
+		return ranges.empty() || ranges.begin()->first != 0 ? 0 : ranges.begin()->second;
+	}
+
+	std::vector<std::pair<long long, long long>> getMissingRanges()
+	{
+		std::vector<std::pair<long long, long long>> missing;
+		long long pos = 0;
+		for (auto const& [start, end] : ranges)
+		{
+			if (start > pos)
+			{
+				missing.push_back(std::make_pair(pos, start));
+			}
+			pos = end;
+		}
+		if (pos < expectedSize)
+		{
+			missing.push_back(std::make_pair(pos, expectedSize));
+		}
+		return missing;
+	}
+
+	void addRange(long long start, long long end)
+	{
+		if (end <= start)
+		{
+			return;
+		}
+		auto it = ranges.upper_bound(start);
+		if (it != ranges.begin() && std::prev(it)->second >= start)
+		{
+			it = std::prev(it);
+		}
+		// in-order chunks touch only the last range, so it is merged at once
+		while (it != ranges.end() && it->first <= end)
+		{
+			if (it->first < start)
+			{
+				start = it->first;
+			}
+			if (it->second > end)
+			{
+				end = it->second;
+			}
+			received -= it->second - it->first;
+			it = ranges.erase(it);
+		}
+		ranges[start] = end;
+		received += end - start;
+	}
+};
+
+class TvPortSlot;
+
+struct TvPortSlotSnapshot {
+	int slotNumber = 0;
+	int generation = 0;
+	// with the slot folder, empty when the slot is not ready
+	std::vector<std::string> files;
+	std::vector<int> durations;
+	std::vector<bool> videos;
+	// as /info shows them
+	std::string allFiles;
+	std::string allDurations;
+
+	int getScreenNumber() const
+	{
+		return (int)files.size();
+	}
+
+	std::string getFileName(int screen) const
+	{
+		return screen < files.size() ? files.at(screen) : "";
+	}
+
+	int getDuration(int screen) const
+	{
+		return screen < durations.size() ? durations.at(screen) : 3;
+	}
+
+	bool isVideo(int screen) const
+	{
+		return screen < videos.size() && videos.at(screen);
+	}
+};
+
+// one chunk of a file, written piece by piece while it arrives from the network
+struct TvPortUpload {
+	TvPortSlot* slot = nullptr;
+	int playlistId = 0;
+	int fileNo = -1;
+	long long filePos = 0;
+	long long size = 0;
+	long long written = 0;
+	bool checked = false;
+	// the check sum of the chunk, summed while the pieces pass through the memory
+	uint32_t checksum = 0;
+	std::fstream fs;
+
+	void write(const char* data, size_t pieceSize)
+	{
+		if (fileNo < 0)
+		{
+			return;
+		}
+		if (written + (long long)pieceSize > size)
+		{
+			pieceSize = (size_t)(size - written);
+		}
+		fs.write(data, pieceSize);
+		if (checked)
+		{
+			checksum = TvChecksum::update(checksum, data, pieceSize);
+		}
+		written += pieceSize;
 	}
 };
 
@@ -73,15 +314,32 @@ class TvPortSlot
 	const std::string configFilePath = "config.json";
 public:
 	int slotNumber;
-	bool isReady = false, isCorrupted=false, readyToSwitch=false;
+	bool isReady = false, isCorrupted=false;
 	std::string pathPrefix;
 	std::string reason;
 
 	std::vector<std::string> file;
 	std::vector<int> duration;
-	std::map<std::string, int> problems;
+	// the config asks for the check sums of its file names to be verified
+	bool checksumsVerified = false;
+	std::vector<TvPortFileState> fileStates;
+	int completeFiles = 0;
+	// made when the slot becomes ready, it is published when the slot becomes current
+	std::shared_ptr<const TvPortSlotSnapshot> readySnapshot;
+	// guards fileStates and journal, the chunks of the slot may be uploaded by several connections at the same time
+	std::mutex uploadMutex;
+	TvUploadJournal journal;
+	// CRC-32C of the text of config.json, the journal is valid only for this config
+	uint32_t configChecksum = 0;
+	// the generation number of the playlist, the master activates the staged playlists by it
+	int playlistId = 0;
+	// false for a staged playlist, it waits for its activation when it is ready
+	bool activateWhenReady = true;
+	// for the LRU order of the staged slots
+	long long lastUsed = 0;
 
-	TvPortSlot(int slot)
+	// slot 0 is the web root, which everybody can read, it gets no journal and is verified on the disk at every start
+	TvPortSlot(int slot) : journal(slot == 0 ? "" : std::to_string(slot) + "/" + TVPORT_JOURNAL_FILE)
 	{
 		slotNumber = slot;
 		pathPrefix = std::to_string(slot);
@@ -89,6 +347,12 @@ public:
 			filesystem::create_directory(pathPrefix);
 		}
 		pathPrefix += "/";
+		if (slot == 0)
+		{
+			// the journal written by a former version is not served
+			std::error_code ec;
+			filesystem::remove(pathPrefix + TVPORT_JOURNAL_FILE, ec);
+		}
 	}
 
     int getScreenNumber() 
@@ -156,18 +420,72 @@ public:
 		return screen < file.size() && filePathContainVideo(file.at(screen));
 	}
 
+	std::shared_ptr<const TvPortSlotSnapshot> makeSnapshot(int generation)
+	{
+		std::shared_ptr<TvPortSlotSnapshot> snapshot = std::make_shared<TvPortSlotSnapshot>();
+		snapshot->slotNumber = slotNumber;
+		snapshot->generation = generation;
+		int n = getScreenNumber();
+		for (int i = 0; i < n; i++)
+		{
+			snapshot->files.push_back(getSlotFileName(i));
+			snapshot->durations.push_back(getSlotDuration(i));
+			snapshot->videos.push_back(isSlotVideo(i));
+		}
+		snapshot->allFiles = getAllFiles();
+		snapshot->allDurations = getAllDurations();
+		return snapshot;
+	}
+
 	bool readConfigFile(std::string path)
 	{
 		std::ifstream ifs(path);
 		std::string input(std::istreambuf_iterator<char>(ifs), {});
+		configChecksum = TvChecksum::update(0, input.data(), input.size());
 
 		TvPortConfiguration conf = json::value_to<TvPortConfiguration>(json::parse(input));
 		file = conf.file;
 		duration = conf.duration;
+		checksumsVerified = conf.checksum == TVPORT_CHECKSUM_CRC32C;
 		return !conf.file.empty();
 	}
 
-	bool readSlot()
+	// newPlaylistId is taken when the slot has no valid journal
+	bool readSlot(int newPlaylistId)
+	{
+		if (!readConfig())
+		{
+			return false;
+		}
+		std::vector<TvUploadJournalRecord> records;
+		if (readJournal(records))
+		{
+			restoreSlot(records);
+		}
+		else
+		{
+			playlistId = newPlaylistId;
+			journal.recordConfig(configChecksum, playlistId, activateWhenReady);
+			verifySlot();
+		}
+		return isReady;
+	}
+
+	// a slot of the former run comes back from its journal, false when it has no valid journal,
+	// finished is false when its upload was cut by the restart
+	bool resumeSlot(bool& finished)
+	{
+		std::vector<TvUploadJournalRecord> records;
+		if (!readConfig() || !readJournal(records))
+		{
+			return false;
+		}
+		finished = std::any_of(records.begin(), records.end(), [](const TvUploadJournalRecord& record) { return record.type == 'V'; });
+		restoreSlot(records);
+		return !isCorrupted;
+	}
+
+	bool readConfig()
 	{
 		isCorrupted = false;
 		isReady = false;
@@ -184,12 +502,124 @@ public:
 			reason = "Corrupted config file context";
 			return false;
 		}
-		return verifySlot();
+		return true;
 	}
 
-	bool verifySlot()
+	// true when the journal exists and belongs to the config, the playlist gets its id back
+	bool readJournal(std::vector<TvUploadJournalRecord>& records)
+	{
+		if (!journal.read(records) || records.empty() || records.front().type != 'C' || records.front().checksum != configChecksum)
+		{
+			return false;
+		}
+		playlistId = records.front().playlistId;
+		activateWhenReady = records.front().activate != 0;
+		lastUsed = playlistId;
+		return true;
+	}
+
+	// the states of the files as the journal left them, only the .part files of the unfinished uploads are looked for
+	void restoreSlot(const std::vector<TvUploadJournalRecord>& records)
 	{
 		isReady = false;
+		if (!prepareFileStates())
+		{
+			return;
+		}
+		int n = (int)file.size();
+		std::vector<bool> completed(n, false);
+		bool verified = false;
+		for (const TvUploadJournalRecord& record : records)
+		{
+			if (record.type == 'V')
+			{
+				verified = true;
+				continue;
+			}
+			if (record.fileNo < 0 || record.fileNo >= n)
+			{
+				continue;
+			}
+			TvPortFileState& state = fileStates.at(record.fileNo);
+			switch (record.type)
+			{
+			case 'R':
+				state.addRange(record.start, record.end);
+				if (state.expectedChecksum != 0)
+				{
+					state.addChecksum(record.start, record.end, (uint32_t)record.checksum);
+				}
+				break;
+			case 'P':
+				state.addRange(record.start, record.end);
+				break;
+			case 'X':
+				state.reset(state.expectedSize);
+				state.checksumFailures++;
+				completed.at(record.fileNo) = false;
+				break;
+			case 'F':
+				state.reset(state.expectedSize);
+				state.addRange(0, state.expectedSize);
+				completed.at(record.fileNo) = true;
+				break;
+			}
+		}
+		std::unique_lock<std::mutex> lock(uploadMutex);
+		completeFiles = 0;
+		for (int i = 0; i < n; i++)
+		{
+			TvPortFileState& state = fileStates.at(i);
+			checkFailures(i);
+			if (completed.at(i) || state.ranges.empty())
+			{
+				completeFiles += completed.at(i) ? 1 : 0;
+				continue;
+			}
+			state.allocated = filesystem::exists(getPartFileName(i));
+			if (!state.allocated)
+			{
+				// the .part file is lost, the file is uploaded again
+				state.reset(state.expectedSize);
+				journal.recordReset(i);
+			}
+			else if (state.isComplete())
+			{
+				// the restart came between the last range and the rename
+				if (!checkSlotFile(i, lock))
+				{
+					failChecksum(i);
+				}
+				else if (completeSlotFile(i).size() > 0)
+				{
+					state.reset(state.expectedSize);
+					state.allocated = true;
+					journal.recordReset(i);
+				}
+			}
+		}
+		lock.unlock();
+		if (isCorrupted)
+		{
+			journal.sync();
+		}
+		else if (verified)
+		{
+			isReady = true;
+		}
+		else if (completeFiles == n)
+		{
+			verifySlot();
+		}
+		else
+		{
+			journal.sync();
+		}
+	}
+
+	// checks the names and durations of the config, the states of the files start empty
+	bool prepareFileStates()
+	{
 		int n = (int) file.size();
 		if (n == 0 || duration.size() != n)
 		{
@@ -197,8 +627,8 @@ public:
 			reason = "Incorrect size of file or duration";
 			return false;
 		}
-		problems.clear();
-		isReady = true;
+		fileStates.assign(n, TvPortFileState());
+		completeFiles = 0;
 		for (int i = 0; i < n; i++)
 		{
 			int varighet = duration.at(i);
@@ -206,40 +636,110 @@ public:
 			if (fil.size() < 4 || (fil.at(0) != 'v' && fil.at(0) != 'i'))
 			{
 				isCorrupted = true;
-				isReady = false;
 				reason = "Incorrect file name start at " + std::to_string(i) + " of " + fil;
 				return false;
 			}
 			if (varighet <= 0 && fil.at(0) == 'i')
 			{
 				isCorrupted = true;
-				isReady = false;
 				reason = "Incorrect duration at " + std::to_string(i) + " of " + std::to_string(varighet);
 				return false;
 			}
-			long sizeExpected = getExpectedFileSize(i);
+			long long sizeExpected = getExpectedFileSize(i);
 			if (sizeExpected <= 0)
 			{
 				return false;
 			}
+			TvPortFileState& state = fileStates.at(i);
+			state.reset(sizeExpected);
+			state.expectedChecksum = getExpectedChecksum(i);
+		}
+		return true;
+	}
+
+	bool verifySlot()
+	{
+		isReady = false;
+		if (!prepareFileStates())
+		{
+			return false;
+		}
+		isReady = true;
+		int n = (int) file.size();
+		for (int i = 0; i < n; i++)
+		{
+			std::string fil = file.at(i);
 			std::string filName = pathPrefix + fil;
-			if (!filesystem::exists(filName))
+			std::string partName = getPartFileName(i);
+			TvPortFileState& state = fileStates.at(i);
+			long long sizeExpected = state.expectedSize;
+			std::error_code ec;
+			if (!filesystem::exists(filName, ec) && state.expectedChecksum != 0)
+			{
+				// an unchanged file of the former configs
+				TvMediaStore::fetch(fil, filName, sizeExpected);
+			}
+			if (!filesystem::exists(filName, ec))
 			{
 				isReady = false;
-				problems[filName] = 0;
+				uintmax_t partSize = filesystem::file_size(partName, ec);
+				state.allocated = !ec && partSize == (uintmax_t)sizeExpected;
 			}
 			else
 			{
-				uintmax_t fileSize = filesystem::file_size(filName);
-				if (fileSize != (uintmax_t)sizeExpected) {
+				uintmax_t fileSize = filesystem::file_size(filName, ec);
+				if (ec || fileSize != (uintmax_t)sizeExpected) {
 					isReady = false;
-					problems[filName] = (int)fileSize;
+					// a file appended by the former uploads continues as .part, a bigger file is uploaded again,
+					// the files of slot 0, the web root, are never changed. A file which cannot be renamed,
+					// e.g. it is open on Windows, stays, the upload writes a new .part file, which replaces it at the end
+					if (!ec && slotNumber != 0)
+					{
+						filesystem::rename(filName, partName, ec);
+						if (!ec)
+						{
+							filesystem::resize_file(partName, sizeExpected, ec);
+						}
+						if (ec)
+						{
+							std::cout << "File " << filName << " cannot be continued: " << ec.message() << std::endl;
+						}
+						else
+						{
+							state.allocated = true;
+							if (fileSize < (uintmax_t)sizeExpected) {
+								state.addRange(0, (long long)fileSize);
+								journal.recordRange(i, 0, (long long)fileSize, partName);
+							}
+						}
+					}
+				}
+				else {
+					state.addRange(0, sizeExpected);
+					journal.recordFile(i, false);
+					if (state.expectedChecksum != 0)
+					{
+						TvMediaStore::publish(fil, filName);
+					}
 				}
 			}
+			if (state.isComplete())
+			{
+				completeFiles++;
+			}
+		}
+		if (isReady)
+		{
+			journal.recordVerified();
+		}
+		else
+		{
+			journal.sync();
 		}
 		return isReady;
 	}
 
+	// the files already in the folder or in the store are looked for, the journal starts with the new config
 	std::string uploadConfig(std::string configData)
 	{
 		std::ofstream conf(pathPrefix + configFilePath);
@@ -250,7 +750,11 @@ public:
 		else {
 			return "Unable to create config.json file.\n";
 		}
-		readSlot();
+		if (readConfig())
+		{
+			journal.recordConfig(configChecksum, playlistId, activateWhenReady);
+			verifySlot();
+		}
 		return getCommonStatus();
 	}
 
@@ -268,17 +772,57 @@ public:
 		else
 		{
 			bool first = true;
-			for (auto const& [key, val] : problems)
+			int n = (int)fileStates.size();
+			for (int i = 0; i < n; i++)
 			{
-				ss << (first ? "{" : ",") << "\"" << key << "\":" << val;
+				TvPortFileState& state = fileStates.at(i);
+				if (state.isComplete() && !state.renamePending)
+				{
+					continue;
+				}
+				ss << (first ? "{" : ",") << "\"" << pathPrefix + file.at(i) << "\":[";
+				bool firstRange = true;
+				// the file waiting for its rename asks for its last byte, so the master sends a chunk which tries the rename again
+				std::vector<std::pair<long long, long long>> missing = state.renamePending
+					? std::vector<std::pair<long long, long long>>{ { state.expectedSize - 1, state.expectedSize } } : state.getMissingRanges();
+				for (auto const& [start, end] : missing)
+				{
+					ss << (firstRange ? "[" : ",[") << start << "," << end << "]";
+					firstRange = false;
+				}
+				ss << "]";
 				first = false;
 			}
-			ss << "}";
+			ss << (first ? "{}" : "}");
 		}
 		return ss.str();
 	}
 
-	long getExpectedFileSize(int pos)
+	std::string getPartFileName(int fileNo)
+	{
+		return pathPrefix + file.at(fileNo) + ".part";
+	}
+
+	// the digits between '_' and '-', 0 when they are missing or the config does not ask for the check
+	uint32_t getExpectedChecksum(int pos)
+	{
+		if (!checksumsVerified)
+		{
+			return 0;
+		}
+		std::string fil = file.at(pos);
+		size_t minusPos = fil.find('-');
+		size_t underPos = minusPos == std::string::npos ? std::string::npos : fil.rfind('_', minusPos);
+		long long checksum;
+		if (underPos == std::string::npos || sscanf_s(fil.substr(underPos + 1, minusPos - underPos - 1).c_str(), "%lld", &checksum) != 1
+			|| checksum < 0 || checksum > 0xFFFFFFFFLL)
+		{
+			return 0;
+		}
+		return (uint32_t)checksum;
+	}
+
+	long long getExpectedFileSize(int pos)
 	{
 		std::string fil = file.at(pos);
 		size_t minusPos = fil.find('-');
@@ -291,8 +835,8 @@ public:
 			return -1;
 		}
 		std::string sizeStr = fil.substr(minusPos + 1, pointPos - minusPos - 1);
-		long sizeExpected;
-		if (sscanf_s(sizeStr.c_str(), "%ld", &sizeExpected) != 1 || sizeExpected <= 0)
+		long long sizeExpected;
+		if (sscanf_s(sizeStr.c_str(), "%lld", &sizeExpected) != 1 || sizeExpected <= 0)
 		{
 			isCorrupted = true;
 			isReady = false;
@@ -302,35 +846,123 @@ public:
 		return sizeExpected;
 	}
 
-	std::string saveSlotFile(int fileNo, long filePos, int storrelse, char* data)
+	// creates the .part file at its full size, so every chunk can be written at its position, called under uploadMutex
+	std::string allocateSlotFile(int fileNo, long long expectedSize)
 	{
-		std::string fileName = pathPrefix + file.at(fileNo);
-		if (filePos == 0)
+		TvPortFileState& state = fileStates.at(fileNo);
+		if (state.allocated)
 		{
-			std::ofstream fs(fileName, std::ios::out | std::ios::binary | std::ios::app);
-			fs.write(data, storrelse);
-			fs.close();
+			return "";
 		}
-		else {
-			if (!filesystem::exists(fileName))
+		std::string partName = getPartFileName(fileNo);
+		if (!filesystem::exists(partName))
+		{
+			std::ofstream fs(partName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!fs.is_open())
 			{
-				return "File " + fileName + " does not exist, so it cannot be written at this position " + std::to_string(filePos);
+				return "File " + partName + " cannot be created";
 			}
-			uintmax_t fileSize = filesystem::file_size(fileName);
-			if (fileSize < filePos)
+		}
+		std::error_code ec;
+		filesystem::resize_file(partName, expectedSize, ec);
+		if (ec)
+		{
+			return "File " + partName + " cannot be allocated at size " + std::to_string(expectedSize) + ": " + ec.message();
+		}
+		state.allocated = true;
+		return "";
+	}
+
+	// the file is read again only when its chunks could not be summed while uploading, called under uploadMutex
+	bool checkSlotFile(int fileNo, std::unique_lock<std::mutex>& lock)
+	{
+		TvPortFileState& state = fileStates.at(fileNo);
+		if (state.expectedChecksum == 0)
+		{
+			return true;
+		}
+		uint32_t checksum = state.checksum;
+		if (state.checksumSize != state.expectedSize)
+		{
+			std::string partName = getPartFileName(fileNo);
+			long long size = state.expectedSize;
+			lock.unlock();
+			bool success = TvChecksum::computeFile(partName, size, checksum);
+			lock.lock();
+			if (!success)
 			{
-				return "File " + fileName + " is too small " + std::to_string(fileSize) + " so it cannot be saved at position " + std::to_string(filePos);
+				return false;
 			}
-			std::fstream fs(fileName, std::ios::binary | std::ios::out | std::ios::in);
-			fs.seekp(filePos, std::ios::beg); // Move the write pointer to position 
-			fs.write(data, storrelse); // Write data at position filePos
-			fs.close();
 		}
+		return checksum == fileStates.at(fileNo).expectedChecksum;
+	}
+
+	// the file is uploaded again, called under uploadMutex
+	void failChecksum(int fileNo)
+	{
+		TvPortFileState& failed = fileStates.at(fileNo);
+		failed.reset(failed.expectedSize);
+		failed.allocated = true;
+		failed.checksumFailures++;
+		journal.recordReset(fileNo);
+		checkFailures(fileNo);
+	}
+
+	// a file which keeps failing its check sum is not requested again, the master gets the error and sends a new config
+	void checkFailures(int fileNo)
+	{
+		if (fileStates.at(fileNo).checksumFailures >= TVPORT_CHECKSUM_MAXIMUM_FAILURES)
+		{
+			isCorrupted = true;
+			isReady = false;
+			reason = "Check sum of " + file.at(fileNo) + " failed " + std::to_string(fileStates.at(fileNo).checksumFailures) + " times";
+		}
+	}
+
+	// the last range has arrived, the file gets its name, called under uploadMutex
+	std::string completeSlotFile(int fileNo)
+	{
+		// the ranges of the .part file reach the disk before it is renamed
+		journal.sync();
+		std::error_code ec;
+		filesystem::rename(getPartFileName(fileNo), pathPrefix + file.at(fileNo), ec);
+		if (ec)
+		{
+			fileStates.at(fileNo).renamePending = true;
+			return "File " + file.at(fileNo) + " cannot be completed: " + ec.message();
+		}
+		fileStates.at(fileNo).renamePending = false;
+		if (fileStates.at(fileNo).expectedChecksum != 0)
+		{
+			TvMediaStore::publish(file.at(fileNo), pathPrefix + file.at(fileNo));
+		}
+		journal.recordFile(fileNo, true);
+		completeFiles++;
 		return "";
 	}
 
-	// nr must be of this format X_XXXXXX, where X is the file number in the slot, XXXXXX is the current position in the file
-	std::string uploadFile(std::string nr, int uploadedSize, char* data) {
+	// a repeated chunk of a completed file changes nothing, but the rename which failed before is tried again, called under uploadMutex
+	std::string retryCompleteSlotFile(int fileNo)
+	{
+		if (fileStates.at(fileNo).renamePending)
+		{
+			std::string message = completeSlotFile(fileNo);
+			if (message.size() > 0)
+			{
+				return message;
+			}
+			if (completeFiles == (int)file.size())
+			{
+				verifySlot();
+			}
+		}
+		return getCommonStatus();
+	}
+
+	// nr must be of this format X_XXXXXX, where X is the file number in the slot, XXXXXX is the position of the chunk in the file,
+	// the chunks may come in any order.
+	// Returns an empty string when the upload is ready to receive its bytes, otherwise the reply for the master
+	std::string startUpload(std::string nr, long long uploadedSize, TvPortUpload& upload) {
 		size_t underPos = nr.find("_");
 		if (underPos == std::string::npos || underPos < 1)
 		{
@@ -339,16 +971,21 @@ public:
 		std::string firstNmb = nr.substr(0, underPos);
 		std::string secondNmb = nr.substr(underPos + 1);
 		int fileNo;
-		long filePos;
-		if (sscanf_s(firstNmb.c_str(), "%d", &fileNo) != 1 || fileNo < 0 || fileNo >= file.size())
+		long long filePos;
+		std::unique_lock<std::mutex> lock(uploadMutex);
+		if (isCorrupted)
+		{
+			return getCommonStatus();
+		}
+		if (sscanf_s(firstNmb.c_str(), "%d", &fileNo) != 1 || fileNo < 0 || fileNo >= file.size() || fileNo >= fileStates.size())
 		{
 			return "Error in the file no  with limit of " + std::to_string(file.size());
 		}
-		if (sscanf_s(secondNmb.c_str(), "%ld", &filePos) != 1 || filePos < 0 || uploadedSize<=0)
+		if (sscanf_s(secondNmb.c_str(), "%lld", &filePos) != 1 || filePos < 0 || uploadedSize<=0)
 		{
 			return "Error in the file position of " + secondNmb;
 		}
-		long expectedSize = getExpectedFileSize(fileNo);
+		long long expectedSize = getExpectedFileSize(fileNo);
 		if (expectedSize <= 0)
 		{
 			return "Corrupted expected size " + std::to_string(expectedSize);
@@ -357,15 +994,142 @@ public:
 		{
 			return "Exceeded expected file size " + std::to_string(expectedSize) + " while filePos= " + std::to_string(filePos) + " size=" + std::to_string(uploadedSize);
 		}
-		std::string message = saveSlotFile(fileNo, filePos, uploadedSize, data);
+		if (fileStates.at(fileNo).isComplete())
+		{
+			return retryCompleteSlotFile(fileNo);
+		}
+		std::string message = allocateSlotFile(fileNo, expectedSize);
 		if (message.size() > 0)
 		{
 			return message;
 		}
-		readSlot();
+		// the chunks are written without holding uploadMutex: a chunk sent again over a slow link may overlap another one,
+		// but both write the same bytes at the same positions, and a sum broken by the overlap is computed from the disk at the end
+		std::string partName = getPartFileName(fileNo);
+		upload.fs.open(partName, std::ios::binary | std::ios::out | std::ios::in);
+		if (!upload.fs.is_open())
+		{
+			return "File " + partName + " does not exist, so it cannot be written at this position " + std::to_string(filePos);
+		}
+		upload.fs.seekp(filePos, std::ios::beg);
+		upload.fileNo = fileNo;
+		upload.filePos = filePos;
+		upload.size = uploadedSize;
+		upload.checked = fileStates.at(fileNo).expectedChecksum != 0;
+		return "";
+	}
+
+	// all bytes of the chunk are on the disk, the state of the file is updated
+	std::string finishUpload(TvPortUpload& upload) {
+		std::string res = finishChunk(upload);
+		// the batch of the journal is flushed after uploadMutex is released, the other chunks do not wait for it
+		journal.syncIfDue();
+		return res;
+	}
+
+	std::string finishChunk(TvPortUpload& upload) {
+		if (upload.fileNo < 0)
+		{
+			return "Error: the upload has not started";
+		}
+		upload.fs.close();
+		if (upload.fs.fail())
+		{
+			return "File " + file.at(upload.fileNo) + " cannot be written at position " + std::to_string(upload.filePos);
+		}
+		if (upload.written != upload.size)
+		{
+			return "Incomplete chunk of " + std::to_string(upload.written) + " bytes instead of " + std::to_string(upload.size);
+		}
+		int fileNo = upload.fileNo;
+		long long filePos = upload.filePos;
+		std::unique_lock<std::mutex> lock(uploadMutex);
+		TvPortFileState& state = fileStates.at(fileNo);
+		if (state.isComplete())
+		{
+			return retryCompleteSlotFile(fileNo);
+		}
+		state.addRange(filePos, filePos + upload.size);
+		if (upload.checked)
+		{
+			state.addChecksum(filePos, filePos + upload.size, upload.checksum);
+			journal.recordRange(fileNo, filePos, filePos + upload.size, upload.checksum, getPartFileName(fileNo));
+		}
+		else
+		{
+			journal.recordRange(fileNo, filePos, filePos + upload.size, getPartFileName(fileNo));
+		}
+		if (state.isComplete())
+		{
+			if (!checkSlotFile(fileNo, lock))
+			{
+				std::cout << "Check sum mismatch in " << file.at(fileNo) << ", it must be uploaded again" << std::endl;
+				failChecksum(fileNo);
+				return getCommonStatus();
+			}
+			std::string message = completeSlotFile(fileNo);
+			if (message.size() > 0)
+			{
+				return message;
+			}
+		}
+		// the slot is checked on the disk only once, when the last byte of the last file arrives
+		if (completeFiles == (int)file.size())
+		{
+			verifySlot();
+		}
 		return getCommonStatus();
 	}
 
+	// the whole chunk is in memory
+	std::string uploadFile(std::string nr, long long uploadedSize, char* data) {
+		TvPortUpload upload;
+		std::string message = startUpload(nr, uploadedSize, upload);
+		if (message.size() > 0)
+		{
+			return message;
+		}
+		upload.write(data, (size_t)uploadedSize);
+		return finishUpload(upload);
+	}
+
+	// the files made from the files of the config which are still used: the .part file of an upload,
+	// and the scaled copy and the raw clip of a video for the current screen, also while they are written.
+	// The copies for a former padding or screen and the leftovers of an interrupted scaling are not kept
+	bool isDerivedFile(std::string name)
+	{
+		for (const std::string& fil : file)
+		{
+			if (name.size() <= fil.size() || name.compare(0, fil.size(), fil) != 0 || name.at(fil.size()) != '.')
+			{
+				continue;
+			}
+			std::string scaledName = TvIngestWorker::getScaledFileName(fil);
+			std::string rawName = TvIngestWorker::getRawFileName(fil);
+			if (name == fil + ".part" || name == scaledName || name == rawName
+				|| name == TvIngestWorker::getPartFileName(scaledName) || name == TvIngestWorker::getPartFileName(rawName))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// the videos are scaled to the screen in the background, after that they are played without resizing
+	void scaleVideos()
+	{
+		int n = (int)file.size();
+		for (int i = 0; i < n; i++)
+		{
+			if (isSlotVideo(i))
+			{
+				tvIngestWorker.enqueue(getSlotFileName(i));
+			}
+		}
+	}
+
+	// the files are only queued for the janitor, removing a file of the store only drops one link to it,
+	// the janitor frees the files of the store nobody refers to after enqueueCollect
 	void cleanUnnecessaryFiles(bool forceAll)
 	{
 		if (!forceAll && isCorrupted) {
@@ -377,11 +1141,12 @@ public:
 		}
 		if (forceAll) 
 		{
+			journal.close();
 			for (const auto& entry : filesystem::directory_iterator(pathPrefix))
 			{
 				if (entry.is_regular_file())
 				{
-					filesystem::remove_all(entry.path());
+					tvJanitor.enqueue(entry.path());
 				}
 			}
 		}
@@ -392,11 +1157,11 @@ public:
 				{
 					filesystem::path p = entry.path();
 					std::string s = p.filename().string();
-					if (s == configFilePath || find(file.begin(), file.end(), s) != file.end())
+					if (s == configFilePath || s == TVPORT_JOURNAL_FILE || find(file.begin(), file.end(), s) != file.end() || isDerivedFile(s))
 					{
 						continue;
 					}
-					filesystem::remove_all(p);
+					tvJanitor.enqueue(p);
 				}
 			}
 		}
@@ -405,10 +1170,62 @@ public:
 
 class TvPortSlots
 {
-	volatile int currentSlot;
+	// the slot to show: the current one, or the next one as soon as it is ready
+	std::atomic<int> currentSlot;
+	// changes every time the current slot is replaced, the caches of the screen are valid only for one generation
+	std::atomic<int> slotGeneration{ 0 };
 	TvPortSlot *current = nullptr;
+	// the slot of the last config, the chunks are uploaded into it
 	TvPortSlot *next = nullptr;
+	// the ready slot which the render thread switches to at the end of its item
+	TvPortSlot *activated = nullptr;
+	// the ready slots which are not shown by slot number: the staged playlists and the former current slots
+	std::map<int, TvPortSlot*> staged;
+	// all slots in memory by playlist id, so a playlist is activated at once
+	std::unordered_map<int, TvPortSlot*> playlists;
+	long long useClock = 0;
+	// guards current, next, activated, staged and playlists
 	std::mutex switchToNextMutex;
+	// the http handlers run on several threads: a new config is taken alone, the uploads run together
+	// and the next slot they write to is not deleted under them
+	std::shared_mutex configMutex;
+	// one new config at a time, it holds configMutex only while the next slot is replaced, the reading of its folder,
+	// which may copy big files from the store, runs under this mutex only. A reloaded staged slot takes it too,
+	// so a new config does not take its folder while it is read
+	std::mutex newConfigMutex;
+	std::atomic<std::shared_ptr<const TvPortSlotSnapshot>> snapshot{ std::make_shared<const TvPortSlotSnapshot>() };
+	// the snapshot of the next slot, which is ready to be switched to
+	std::atomic<std::shared_ptr<const TvPortSlotSnapshot>> readySnapshot;
+	std::mutex switchEventMutex;
+	std::condition_variable switchEvent;
+	std::chrono::steady_clock::time_point readyTime;
+	std::atomic<bool> isFirstFrameAwaited{ false };
+	// in microseconds, from the slot ready to its first frame on the screen, -1 before the first switch
+	std::atomic<long long> switchLatency{ -1 };
+
+	// called every time current is replaced
+	void publishSnapshot()
+	{
+		std::shared_ptr<const TvPortSlotSnapshot> published = current == nullptr ? std::make_shared<const TvPortSlotSnapshot>() : current->readySnapshot;
+		if (published == nullptr)
+		{
+			published = current->makeSnapshot(++slotGeneration);
+		}
+		snapshot.store(published, std::memory_order_release);
+		readySnapshot.store(nullptr, std::memory_order_release);
+	}
+
+	// the slot to show has changed, the render thread is woken
+	void signalSwitch(int slot)
+	{
+		{
+			std::lock_guard<std::mutex> lock(switchEventMutex);
+			readyTime = std::chrono::steady_clock::now();
+			currentSlot.store(slot, std::memory_order_release);
+		}
+		isFirstFrameAwaited.store(true, std::memory_order_release);
+		switchEvent.notify_all();
+	}
 public:
 	TvPortSlots()
 	{
@@ -424,144 +1241,519 @@ public:
 			delete current;
 			current = readSlot(currentSlot);
 		}
+		current->scaleVideos();
+		publishSnapshot();
+		std::unique_lock<std::mutex> lock(switchToNextMutex);
+		playlists[current->playlistId] = current;
+		useClock = current->playlistId;
+		// the other slots of the ring come back from their journals: the verified ones are staged again,
+		// the upload of the newest unfinished one goes on without a new config
+		int slotCount = tvConfigStore.get()->slotCount;
+		for (int slot = TVPORT_MINIMUM_SLOT_NUMBER; slot <= slotCount; slot++)
+		{
+			if (slot == currentSlot)
+			{
+				continue;
+			}
+			TvPortSlot* candidate = new TvPortSlot(slot);
+			bool finished = false;
+			if (!candidate->resumeSlot(finished) || (finished && !candidate->isReady))
+			{
+				delete candidate;
+				continue;
+			}
+			useClock = std::max(useClock, candidate->lastUsed);
+			if (finished)
+			{
+				staged[slot] = candidate;
+				playlists[candidate->playlistId] = candidate;
+			}
+			else if (next == nullptr || next->playlistId < candidate->playlistId)
+			{
+				if (next != nullptr)
+				{
+					dropUpload(next);
+				}
+				next = candidate;
+			}
+			else
+			{
+				dropUpload(candidate);
+			}
+		}
+		if (next != nullptr)
+		{
+			std::cout << "Upload of slot " << next->slotNumber << " is resumed from its journal" << std::endl;
+			playlists[next->playlistId] = next;
+		}
+		lock.unlock();
+		checkSlotReadiness();
         return currentSlot;            
     }
+
 	int getCurrentSlotNumber() {
 		return currentSlot;
 	}
 
+	int getSlotGeneration() {
+		return slotGeneration.load();
+	}
+
+	// the playlist of the current slot, it does not change while it is held
+	std::shared_ptr<const TvPortSlotSnapshot> getSnapshot()
+	{
+		return snapshot.load(std::memory_order_acquire);
+	}
+
 	std::string getCurrentSlotFiles()
 	{
-		if (current == nullptr) {
-			return "";
-		}
-		return current->getAllFiles();
+		return getSnapshot()->allFiles;
 	}
 
 	std::string getCurrentSlotDurations()
 	{
-		if (current == nullptr) {
-			return "";
-		}
-		return current->getAllDurations();
+		return getSnapshot()->allDurations;
 	}
 
 	std::string getAllPaddings()
 	{
-		std::string r = std::to_string(ParamUtils::readParameterPaddingTop()) + "," + std::to_string(ParamUtils::readParameterPaddingRight()) + "," + std::to_string(ParamUtils::readParameterPaddingBottom()) + "," + std::to_string(ParamUtils::readParameterPaddingLeft());
-		return r;
+		return tvConfigStore.get()->getAllPaddings();
 	}
 
-    int getCurrentSlotScreens() 
-    {
-		return current == nullptr ? 0 : current->getScreenNumber();
-    }
+	std::string getBackgroundColor()
+	{
+		char buffer[8];
+		sprintf_s(buffer, "#%06x", tvConfigStore.get()->backgroundColor & 0xffffff);
+		return buffer;
+	}
 
 	bool isRequiredToSwitch(int slot) {
-		return slot != currentSlot;
+		return slot != currentSlot.load(std::memory_order_acquire);
 	}
 
-	std::string getCurrentSlotFileName(int screen) 
+	// waits at most delay ms, returns at once when the slot to show changes
+	bool waitForSwitch(int slot, int delay)
 	{
-		return current == nullptr ? "" : current->getSlotFileName(screen);
+		std::unique_lock<std::mutex> lock(switchEventMutex);
+		return switchEvent.wait_for(lock, std::chrono::milliseconds(delay), [this, slot] { return isRequiredToSwitch(slot); });
 	}
 
-	int getCurrentSlotDuration(int screen)
+	// the snapshot of the next slot, nullptr when the slot to show has no snapshot yet
+	std::shared_ptr<const TvPortSlotSnapshot> getReadySnapshot()
 	{
-		return current == nullptr ? 3 : current->getSlotDuration(screen);
+		return readySnapshot.load(std::memory_order_acquire);
 	}
 
-	bool isCurrentSlotVideo(int screen) 
+	// called by the render thread after every shown frame, only the first frame of the new slot is measured
+	void reportFrameShown(int slot)
 	{
-		return current == nullptr ? false : current->isSlotVideo(screen);
+		if (isFirstFrameAwaited.load(std::memory_order_relaxed) && !isRequiredToSwitch(slot) && isFirstFrameAwaited.exchange(false, std::memory_order_acquire))
+		{
+			std::lock_guard<std::mutex> lock(switchEventMutex);
+			switchLatency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - readyTime).count();
+			std::cout << "Slot " << currentSlot.load() << " is on the screen " << switchLatency.load() / 1000.0 << "ms after it became ready" << std::endl;
+		}
+	}
+
+	// in ms, -1 before the first switch
+	double getSwitchLatency()
+	{
+		long long latency = switchLatency.load();
+		return latency < 0 ? -1 : latency / 1000.0;
 	}
 
+	// the former current slot stays staged, so it can be activated again without an upload
 	int switchToCurrentTask()
 	{
 		TvPortSlot* old = nullptr;
+		int slot;
 		switchToNextMutex.lock();
-		if (next != nullptr && next->readyToSwitch) {
+		if (activated != nullptr) {
 			old = current;
-			current = next;
-			next = nullptr;
+			current = activated;
+			activated = nullptr;
+			publishSnapshot();
+			if (old != nullptr && old->isReady && !old->isCorrupted)
+			{
+				stageSlot(old);
+				old = nullptr;
+			}
+			else if (old != nullptr)
+			{
+				playlists.erase(old->playlistId);
+			}
 		}
+		// a switch signalled by another thread after the lock is released is not overwritten
+		if (current!=nullptr) {
+			currentSlot = current->slotNumber;
+		}
+		slot = currentSlot;
 		switchToNextMutex.unlock();
 		if (old!=nullptr) 
 		{
 			if (old->isCorrupted)
 			{
 				old->cleanUnnecessaryFiles(true);
+				tvJanitor.enqueueCollect();
 			}
 			delete old;
 		}
-		if (current!=nullptr) {
-			currentSlot = current->slotNumber;
-		}
-		return currentSlot;
+		return slot;
 	}
 
-	std::string uploadFile(std::string nr, int storrelse, char* data) {
-		if (next != nullptr)
+	TvPortSlot* getNext()
+	{
+		std::lock_guard<std::mutex> lock(switchToNextMutex);
+		return next;
+	}
+
+	std::string uploadFile(std::string nr, long long storrelse, char* data) {
+		std::shared_lock<std::shared_mutex> configLock(configMutex);
+		TvPortSlot* slot = getNext();
+		if (slot != nullptr)
 		{
-			std::string res = next->uploadFile(nr, storrelse, data);
+			std::string res = slot->uploadFile(nr, storrelse, data);
 			checkSlotReadiness();
 			return res;
 		}
 		return "Error: No next config";
 	}
 
-	std::string uploadConfig(std::string configData)
+	// the upload belongs to the next slot of its start, it is refused when a new config has come meanwhile
+	std::string startUpload(std::string nr, long long storrelse, TvPortUpload& upload) {
+		std::shared_lock<std::shared_mutex> configLock(configMutex);
+		TvPortSlot* slot = getNext();
+		if (slot == nullptr)
+		{
+			return "Error: No next config";
+		}
+		upload.slot = slot;
+		upload.playlistId = slot->playlistId;
+		return slot->startUpload(nr, storrelse, upload);
+	}
+
+	std::string finishUpload(TvPortUpload& upload) {
+		std::shared_lock<std::shared_mutex> configLock(configMutex);
+		TvPortSlot* slot = getNext();
+		// a new slot may have got the memory of the slot of the start
+		if (slot == nullptr || slot != upload.slot || slot->playlistId != upload.playlistId)
+		{
+			return "Error: No next config";
+		}
+		std::string res = slot->finishUpload(upload);
+		checkSlotReadiness();
+		return res;
+	}
+
+	// activate is false for a staged playlist, it is kept when it is ready until activatePlaylist is called with its id
+	std::string uploadConfig(std::string configData, bool activate = true)
 	{
+		std::lock_guard<std::mutex> newConfigLock(newConfigMutex);
+		std::unique_lock<std::shared_mutex> configLock(configMutex);
 		TvPortSlot* old = nullptr;
+		bool replaced = false;
+		int slot;
 	    switchToNextMutex.lock();
 		if (next != nullptr)
 		{
 			if (current == nullptr)
 			{
 				current = next;
+				publishSnapshot();
+				replaced = true;
 			} 
 			else {
+				// the unfinished upload is dropped for the new config
 				old = next;
+				playlists.erase(old->playlistId);
 			}
-			currentSlot = current->slotNumber;
 			next = nullptr;
 		}
+		if (activate && activated != nullptr)
+		{
+			// the new config is shown instead of the activated slot, which waits staged
+			stageSlot(cancelActivation());
+		}
+		slot = takeSlotNumber();
+		// the slot to show is changed only here and by cancelActivation, under the lock,
+		// a staged config leaves the activation which has not been switched to yet
+		if (replaced)
+		{
+			signalSwitch(current->slotNumber);
+		}
 		switchToNextMutex.unlock();
 		if (old != nullptr) {
-			delete old;
+			dropUpload(old);
+		}
+		// the new slot is not known to anybody until it is the next slot, it is read and linked from the store without configMutex,
+		// so the uploads, /info and /status go on while the files are copied
+		configLock.unlock();
+		// the files of the former use of the folder must not be removed under the new config
+		tvJanitor.cancel(std::to_string(slot));
+		TvPortSlot* portSlot = new TvPortSlot(slot);
+		portSlot->playlistId = ParamUtils::takeParameterPlaylistId();
+		portSlot->activateWhenReady = activate;
+		std::string res = portSlot->uploadConfig(configData);
+		{
+			std::lock_guard<std::mutex> lock(switchToNextMutex);
+			next = portSlot;
+			playlists[portSlot->playlistId] = portSlot;
 		}
-		int slot = getNextSlotNumber();
-		next = new TvPortSlot(slot);
-		std::string res = next->uploadConfig(configData);
 		checkSlotReadiness();
+		if (!activate)
+		{
+			res = "{\"id\":" + std::to_string(portSlot->playlistId) + ",\"status\":" + res + "}";
+		}
 		return res;
 	}
+
+	// the staged playlist becomes the slot to show, the render thread switches to it at the end of its item,
+	// a playlist still uploading is shown when it is ready
+	std::string activatePlaylist(int id)
+	{
+		std::lock_guard<std::mutex> lock(switchToNextMutex);
+		auto it = playlists.find(id);
+		if (it == playlists.end())
+		{
+			return "{\"Error: Unknown playlist " + std::to_string(id) + "\":0}";
+		}
+		TvPortSlot* slot = it->second;
+		if (slot == next)
+		{
+			std::lock_guard<std::mutex> uploadLock(slot->uploadMutex);
+			slot->activateWhenReady = true;
+			return slot->getCommonStatus();
+		}
+		if (slot == current)
+		{
+			if (activated != nullptr)
+			{
+				stageSlot(cancelActivation());
+			}
+			return "{}";
+		}
+		if (slot != activated)
+		{
+			activateSlot(slot);
+		}
+		return "{}";
+	}
+
+	// slot.txt has been changed from outside: the slot written there is shown, when it is staged
+	void reloadSlotParameter()
+	{
+		std::lock_guard<std::mutex> lock(switchToNextMutex);
+		if (current == nullptr)
+		{
+			return;
+		}
+		int slot = ParamUtils::readParameterSlot();
+		TvPortSlot* shown = activated != nullptr ? activated : current;
+		if (slot == shown->slotNumber)
+		{
+			// written by this program
+			return;
+		}
+		if (slot == current->slotNumber)
+		{
+			stageSlot(cancelActivation());
+			return;
+		}
+		auto it = staged.find(slot);
+		if (it == staged.end())
+		{
+			std::cout << "Slot " << slot << " of " << ParamUtils::getParameterSlotFileName() << " is not ready, slot " << shown->slotNumber << " stays" << std::endl;
+			ParamUtils::writeParameterSlot(shown->slotNumber);
+			return;
+		}
+		activateSlot(it->second);
+	}
+
+	// config.json of the slot has been changed from outside: a staged slot is read again,
+	// the config of the shown slot is taken as a new config, so it goes to a slot of its own and is shown when it is ready
+	void reloadSlotConfig(int slotNumber)
+	{
+		std::ifstream ifs(std::to_string(slotNumber) + "/config.json");
+		std::string content(std::istreambuf_iterator<char>(ifs), {});
+		uint32_t checksum = TvChecksum::update(0, content.data(), content.size());
+		bool isShown;
+		{
+			std::lock_guard<std::mutex> lock(switchToNextMutex);
+			TvPortSlot* known = current != nullptr && current->slotNumber == slotNumber ? current
+				: activated != nullptr && activated->slotNumber == slotNumber ? activated
+				: staged.count(slotNumber) > 0 ? staged.at(slotNumber) : nullptr;
+			// the config of the next slot is written by its upload
+			if (known == nullptr || known->configChecksum == checksum || (next != nullptr && next->slotNumber == slotNumber))
+			{
+				return;
+			}
+			isShown = known == current || known == activated;
+			if (!isShown)
+			{
+				// the journal is written again by the reloaded slot
+				known->journal.close();
+			}
+		}
+		if (isShown)
+		{
+			std::cout << "Config of the shown slot " << slotNumber << " has changed, it is taken as a new config" << std::endl;
+			uploadConfig(content);
+			return;
+		}
+		// a new config does not take the folder while it is read
+		std::lock_guard<std::mutex> newConfigLock(newConfigMutex);
+		std::unique_ptr<TvPortSlot> reloaded(new TvPortSlot(slotNumber));
+		reloaded->readSlot(ParamUtils::takeParameterPlaylistId());
+		std::lock_guard<std::mutex> lock(switchToNextMutex);
+		auto it = staged.find(slotNumber);
+		if (it == staged.end())
+		{
+			return;
+		}
+		TvPortSlot* former = it->second;
+		staged.erase(it);
+		playlists.erase(former->playlistId);
+		delete former;
+		if (!reloaded->isReady || reloaded->isCorrupted)
+		{
+			std::cout << "Changed config of slot " << slotNumber << " is not ready, the slot is dropped" << std::endl;
+			return;
+		}
+		std::cout << "Slot " << slotNumber << " is staged again as playlist " << reloaded->playlistId << std::endl;
+		playlists[reloaded->playlistId] = reloaded.get();
+		stageSlot(reloaded.release());
+	}
+
+	// the playlists in memory: [{"id":1,"slot":2,"state":"current"},...]
+	std::string getPlaylists()
+	{
+		std::lock_guard<std::mutex> lock(switchToNextMutex);
+		std::stringstream ss;
+		bool first = true;
+		for (auto const& [id, slot] : playlists)
+		{
+			std::string state = slot == current ? "current" : slot == activated ? "activated" : slot == next ? "uploading" : "staged";
+			ss << (first ? "" : ",") << "{\"id\":" << id << ",\"slot\":" << slot->slotNumber << ",\"state\":\"" << state << "\"}";
+			first = false;
+		}
+		return ss.str();
+	}
 protected:
 	TvPortSlot *readSlot(int slot)
 	{
 		TvPortSlot *portSlot = new TvPortSlot(slot);
-		portSlot->readSlot();
+		portSlot->readSlot(ParamUtils::takeParameterPlaylistId());
 		return portSlot;
 	}
 
-	int getNextSlotNumber()
+	// the switch which has not happened yet is given up, the current slot stays, called under switchToNextMutex
+	TvPortSlot* cancelActivation()
 	{
-		int slot = current == nullptr ? 1 : current->slotNumber + 1;
-		if (slot > TVPORT_MAXIMUM_SLOT_NUMBER)
+		TvPortSlot* slot = activated;
+		activated = nullptr;
+		readySnapshot.store(nullptr, std::memory_order_release);
+		if (current != nullptr)
 		{
-			slot = TVPORT_MINIMUM_SLOT_NUMBER;
+			ParamUtils::writeParameterSlot(current->slotNumber);
+			currentSlot = current->slotNumber;
 		}
 		return slot;
 	}
 
+	// the unfinished upload is given up, its .part files and its journal go to the janitor,
+	// so it does not come back after a restart instead of the config the master wants
+	void dropUpload(TvPortSlot* slot)
+	{
+		std::cout << "Unfinished playlist " << slot->playlistId << " in slot " << slot->slotNumber << " is dropped" << std::endl;
+		slot->cleanUnnecessaryFiles(true);
+		tvJanitor.enqueueCollect();
+		delete slot;
+	}
+
+	// called under switchToNextMutex
+	void stageSlot(TvPortSlot* slot)
+	{
+		staged[slot->slotNumber] = slot;
+		slot->lastUsed = ++useClock;
+	}
+
+	// a free slot of the ring, or the least recently used staged one, called under switchToNextMutex
+	int takeSlotNumber()
+	{
+		int slotCount = tvConfigStore.get()->slotCount;
+		for (int slot = TVPORT_MINIMUM_SLOT_NUMBER; slot <= slotCount; slot++)
+		{
+			bool used = (current != nullptr && current->slotNumber == slot) || (activated != nullptr && activated->slotNumber == slot) || staged.count(slot) > 0;
+			if (!used)
+			{
+				return slot;
+			}
+		}
+		auto oldest = staged.end();
+		for (auto it = staged.begin(); it != staged.end(); it++)
+		{
+			if (it->first >= TVPORT_MINIMUM_SLOT_NUMBER && it->first <= slotCount && (oldest == staged.end() || it->second->lastUsed < oldest->second->lastUsed))
+			{
+				oldest = it;
+			}
+		}
+		TvPortSlot* evicted = nullptr;
+		if (oldest != staged.end())
+		{
+			evicted = oldest->second;
+			staged.erase(oldest);
+		}
+		else if (activated != nullptr)
+		{
+			// only the shown slot and the activated one are left, the activation is given up for the new config
+			evicted = cancelActivation();
+		}
+		else
+		{
+			return TVPORT_MINIMUM_SLOT_NUMBER;
+		}
+		std::cout << "Playlist " << evicted->playlistId << " in slot " << evicted->slotNumber << " is dropped for the new config" << std::endl;
+		playlists.erase(evicted->playlistId);
+		int slot = evicted->slotNumber;
+		delete evicted;
+		return slot;
+	}
+
+	// the slot becomes the slot to show, called under switchToNextMutex
+	void activateSlot(TvPortSlot* slot)
+	{
+		if (activated != nullptr)
+		{
+			stageSlot(activated);
+		}
+		staged.erase(slot->slotNumber);
+		activated = slot;
+		slot->lastUsed = ++useClock;
+		slot->readySnapshot = slot->makeSnapshot(++slotGeneration);
+		readySnapshot.store(slot->readySnapshot, std::memory_order_release);
+		ParamUtils::writeParameterSlot(slot->slotNumber);
+		signalSwitch(slot->slotNumber);
+	}
+
+	// the ready next slot is shown or staged, its folder is cleaned of the files of the former configs
 	void checkSlotReadiness()
 	{
-		if (next != nullptr && next->isReady && !next->isCorrupted)
+		std::lock_guard<std::mutex> lock(switchToNextMutex);
+		TvPortSlot* slot = next;
+		if (slot != nullptr && slot->isReady && !slot->isCorrupted)
 		{
-			next->cleanUnnecessaryFiles(false);
-			currentSlot = next->slotNumber;
-			ParamUtils::writeParameterSlot(currentSlot);
-			next->readyToSwitch = true;
+			next = nullptr;
+			slot->cleanUnnecessaryFiles(false);
+			tvJanitor.enqueueCollect();
+			slot->scaleVideos();
+			if (slot->activateWhenReady)
+			{
+				activateSlot(slot);
+			}
+			else
+			{
+				stageSlot(slot);
+			}
 		}
 	}
 };
@@ -0,0 +1,272 @@
+/*************************************************************
+TvStaticFiles keeps what the default GET of the http server has learned about the files it serves.
+The resolved paths: the file of each url, checked once to be inside its web folder, so the url is not made canonical again.
+The small files: the web assets and the small slot files up to TVPORT_STATIC_SMALL_FILE_BYTES are kept in memory,
+at most TVPORT_STATIC_CACHE_BYTES of them, the least recently used are dropped first.
+A kept file is served from memory while its size and its time of change are the same as on the disk.
+The size and the time of change of the files right in the folders reported by the file watcher (hot-reload.hpp)
+are kept as well, so such a file is not looked at on the disk again until the watcher reports its change (forget).
+The files of the other folders are looked at for every request.
+The bigger files are not read by the process, the system copies them to the socket (SimpleWeb::FileContent).
+The validators for If-None-Match: a media file of a slot is named by its CRC-32C and its length (see slots.hpp),
+so its strong ETag is taken from the name without reading the file, and the file never changes under its name.
+The other files, the web assets and config.json, get an ETag of their size and time of change, kept with the file.
+**************************************************************/
+
+#ifndef TVPORT_STATIC_FILES_HPP
+#define TVPORT_STATIC_FILES_HPP
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define TVPORT_STATIC_SMALL_FILE_BYTES (256 * 1024)
+#define TVPORT_STATIC_CACHE_BYTES (32 * 1024 * 1024)
+// the resolved paths are forgotten all at once when there are more of them
+#define TVPORT_STATIC_PATH_ENTRIES 4096
+
+struct TvStaticFile {
+	unsigned long long size = 0;
+	std::filesystem::file_time_type modified;
+	// the ETag of the size and the time of change
+	std::string tag;
+	// only for the small files
+	std::shared_ptr<const std::string> content;
+};
+
+class TvStaticFiles
+{
+	struct CachedFile {
+		TvStaticFile file;
+		std::list<std::string>::iterator use;
+	};
+
+	std::mutex pathMutex;
+	std::unordered_map<std::string, std::string> resolvedPaths;
+	std::mutex cacheMutex;
+	// the folders of the file watcher, by their name
+	std::set<std::string> watchedFolders;
+	// the size, the time of change and the tag of the files of the watched folders, without content
+	std::unordered_map<std::string, TvStaticFile> validators;
+	// counts the changes reported by forget, the validators looked at on the disk meanwhile are not kept
+	unsigned long long changes = 0;
+	std::unordered_map<std::string, CachedFile> cachedFiles;
+	// the paths of cachedFiles, the most recently used first
+	std::list<std::string> uses;
+	size_t cachedBytes = 0;
+
+	void forgetCached(const std::string& path)
+	{
+		auto it = cachedFiles.find(path);
+		if (it != cachedFiles.end())
+		{
+			cachedBytes -= it->second.file.content->size();
+			uses.erase(it->second.use);
+			cachedFiles.erase(it);
+		}
+	}
+
+	void keep(const std::string& path, const TvStaticFile& file)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		forgetCached(path);
+		while (!uses.empty() && cachedBytes + file.content->size() > TVPORT_STATIC_CACHE_BYTES)
+		{
+			forgetCached(uses.back());
+		}
+		uses.push_front(path);
+		cachedFiles[path] = CachedFile{ file, uses.begin() };
+		cachedBytes += file.content->size();
+	}
+
+	bool isWatched(const std::string& path)
+	{
+		return watchedFolders.count(std::filesystem::path(path).parent_path().filename().string()) > 0;
+	}
+
+	// the size, the time of change and the tag of the file, from the disk when they are not kept
+	bool findValidators(const std::string& path, TvStaticFile& result)
+	{
+		unsigned long long seenChanges;
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			auto it = validators.find(path);
+			if (it != validators.end())
+			{
+				result = it->second;
+				return true;
+			}
+			seenChanges = changes;
+		}
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(path, ec))
+		{
+			return false;
+		}
+		result.size = std::filesystem::file_size(path, ec);
+		if (!ec)
+		{
+			result.modified = std::filesystem::last_write_time(path, ec);
+		}
+		if (ec)
+		{
+			return false;
+		}
+		std::stringstream ss;
+		ss << "\"" << std::hex << result.size << "-" << result.modified.time_since_epoch().count() << "\"";
+		result.tag = ss.str();
+		result.content = nullptr;
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (changes == seenChanges && isWatched(path))
+		{
+			if (validators.size() >= TVPORT_STATIC_PATH_ENTRIES)
+			{
+				validators.clear();
+			}
+			validators[path] = result;
+		}
+		return true;
+	}
+
+public:
+	// the strong ETag "<check sum>-<length>" of a slot media file named as i<id>_<check sum>-<length>.<extension>,
+	// empty for the other names, like the .part files and the scaled copies, and for the unchecked files, whose check sum is 0
+	static std::string getNameTag(const std::string& path, unsigned long long& length)
+	{
+		std::string name = std::filesystem::path(path).filename().string();
+		size_t minusPos = name.find('-');
+		size_t underPos = minusPos == std::string::npos ? std::string::npos : name.rfind('_', minusPos);
+		size_t pointPos = minusPos == std::string::npos ? std::string::npos : name.find('.', minusPos);
+		if (name.empty() || (name.at(0) != 'i' && name.at(0) != 'v') || underPos == std::string::npos || pointPos == std::string::npos
+			|| pointPos != name.rfind('.'))
+		{
+			return "";
+		}
+		unsigned long long checksum;
+		std::string checksumStr = name.substr(underPos + 1, minusPos - underPos - 1);
+		std::string lengthStr = name.substr(minusPos + 1, pointPos - minusPos - 1);
+		if (checksumStr.empty() || lengthStr.empty() || checksumStr.find_first_not_of("0123456789") != std::string::npos
+			|| lengthStr.find_first_not_of("0123456789") != std::string::npos
+			|| sscanf_s(checksumStr.c_str(), "%llu", &checksum) != 1 || sscanf_s(lengthStr.c_str(), "%llu", &length) != 1
+			|| checksum == 0 || checksum > 0xFFFFFFFFULL || length == 0)
+		{
+			return "";
+		}
+		return "\"" + checksumStr + "-" + lengthStr + "\"";
+	}
+
+	// If-None-Match is "*" or a list of tags, a weak tag matches too
+	static bool matchesTag(const std::string& ifNoneMatch, const std::string& tag)
+	{
+		std::stringstream ss(ifNoneMatch);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			size_t first = item.find_first_not_of(" \t");
+			size_t last = item.find_last_not_of(" \t");
+			if (first == std::string::npos)
+			{
+				continue;
+			}
+			item = item.substr(first, last - first + 1);
+			if (item.rfind("W/", 0) == 0)
+			{
+				item = item.substr(2);
+			}
+			if (item == "*" || item == tag)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// empty when the url has not been resolved yet
+	std::string getResolvedPath(const std::string& url)
+	{
+		std::lock_guard<std::mutex> lock(pathMutex);
+		auto it = resolvedPaths.find(url);
+		return it == resolvedPaths.end() ? "" : it->second;
+	}
+
+	void addResolvedPath(const std::string& url, const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(pathMutex);
+		if (resolvedPaths.size() >= TVPORT_STATIC_PATH_ENTRIES)
+		{
+			resolvedPaths.clear();
+		}
+		resolvedPaths[url] = path;
+	}
+
+	// the file has gone, the url is resolved again next time
+	void forgetResolvedPath(const std::string& url)
+	{
+		std::lock_guard<std::mutex> lock(pathMutex);
+		resolvedPaths.erase(url);
+	}
+
+	// the files right in these folders are reported by forget when they change
+	void watch(const std::vector<std::string>& folders)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		watchedFolders.insert(folders.begin(), folders.end());
+	}
+
+	// the file of the folder has changed, "*" when any file of the folder may have changed
+	void forget(const std::string& folder, const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		changes++;
+		for (auto it = validators.begin(); it != validators.end();)
+		{
+			std::filesystem::path p(it->first);
+			bool changed = p.parent_path().filename().string() == folder && (name == "*" || p.filename().string() == name);
+			it = changed ? validators.erase(it) : std::next(it);
+		}
+	}
+
+	// false when the path is not a readable file, the content is given for the small files only
+	bool find(const std::string& path, TvStaticFile& result)
+	{
+		if (!findValidators(path, result))
+		{
+			return false;
+		}
+		if (result.size > TVPORT_STATIC_SMALL_FILE_BYTES)
+		{
+			return true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			auto it = cachedFiles.find(path);
+			if (it != cachedFiles.end() && it->second.file.size == result.size && it->second.file.modified == result.modified)
+			{
+				uses.splice(uses.begin(), uses, it->second.use);
+				result.content = it->second.file.content;
+				return true;
+			}
+		}
+		std::ifstream ifs(path, std::ios::in | std::ios::binary);
+		auto content = std::make_shared<std::string>(result.size, '\0');
+		if (!ifs.read(content->data(), (std::streamsize)content->size()))
+		{
+			return false;
+		}
+		result.content = content;
+		keep(path, result);
+		return true;
+	}
+};
+
+extern TvStaticFiles tvStaticFiles;
+
+#endif
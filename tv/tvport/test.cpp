@@ -1,8 +1,194 @@
+
 #include "boost/asio/io_service.hpp"
 #include "boost/asio/ip/tcp.hpp"
 #include <iostream>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <windows.h>
+#include <psapi.h>
+#include "opencv2/imgproc.hpp"
+#include "picture-decoder.hpp"
+#include "slots.hpp"
+#include "static-files.hpp"
+#include "upload-journal.hpp"
+#include "test.hpp"
 
 
 int mainTest() {
 	return 0;
-}
\ No newline at end of file
+}
+
+static size_t getPeakWorkingSet()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+}
+
+static double benchmarkDecoding(std::string imagePath, int mode, int rounds, size_t& decodedBytes)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; i++)
+	{
+		cv::Mat img = cv::imread(imagePath, mode);
+		decodedBytes = img.total() * img.elemSize();
+		float factor = TvScreenLayout::calculateScaleToResize(img.size().width, img.size().height, 0.01);
+		if (factor > 0.0001)
+		{
+			cv::Mat dst;
+			cv::resize(img, dst, cv::Size(), factor, factor, cv::INTER_CUBIC);
+		}
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+// compares decoding of the whole picture with the reduced decoding of TvPictureDecoder,
+// the reduced one runs first, because the peak working set of the process never goes down
+int benchmarkPictureDecoding(std::string imagePath, int rounds) {
+	int width, height;
+	if (!TvPictureDecoder::readJpegSize(imagePath, width, height))
+	{
+		std::cout << imagePath << " is not a JPEG file" << std::endl;
+		return 1;
+	}
+	int mode = TvPictureDecoder::chooseReadMode(width, height);
+	size_t reducedBytes = 0, fullBytes = 0;
+	double reducedTime = benchmarkDecoding(imagePath, mode, rounds, reducedBytes);
+	size_t reducedPeak = getPeakWorkingSet();
+	double fullTime = benchmarkDecoding(imagePath, cv::IMREAD_COLOR, rounds, fullBytes);
+	size_t fullPeak = getPeakWorkingSet();
+	std::cout << imagePath << " " << width << "x" << height << " read mode " << mode << std::endl;
+	std::cout << "full:    " << fullTime << " ms, decoded " << fullBytes << " bytes, peak working set " << fullPeak << std::endl;
+	std::cout << "reduced: " << reducedTime << " ms, decoded " << reducedBytes << " bytes, peak working set " << reducedPeak << std::endl;
+	return 0;
+}
+
+static int failedChecks = 0;
+
+static void check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		std::cout << "check failed: " << what << std::endl;
+		failedChecks++;
+	}
+}
+
+// the arrived ranges of a file are merged, the gaps between them are the missing ranges
+static void checkFileRanges()
+{
+	TvPortFileState state;
+	state.reset(100);
+	state.addRange(10, 20);
+	state.addRange(40, 50);
+	std::vector<std::pair<long long, long long>> missing = state.getMissingRanges();
+	check(missing.size() == 3 && missing[0] == std::make_pair(0LL, 10LL) && missing[1] == std::make_pair(20LL, 40LL)
+		&& missing[2] == std::make_pair(50LL, 100LL), "missing ranges between the arrived ranges");
+	check(state.getContiguousSize() == 0 && state.received == 20, "no contiguous bytes without the start");
+	state.addRange(0, 10);
+	state.addRange(15, 45);
+	check(state.ranges.size() == 1 && state.received == 50 && state.getContiguousSize() == 50, "overlapping ranges merged");
+	state.addRange(45, 45);
+	check(state.received == 50, "empty range ignored");
+	state.addRange(50, 100);
+	check(state.isComplete() && state.getMissingRanges().empty(), "all ranges arrived");
+	state.reset(100);
+	check(!state.isComplete() && state.getMissingRanges().size() == 1, "reset forgets the ranges");
+}
+
+// CRC-32C of the standard test string, the sums of the parts joined by combine and by the file state in any order
+static void checkChecksums()
+{
+	std::string data = "123456789";
+	check(TvChecksum::update(0, data.data(), data.size()) == 0xE3069283u, "CRC-32C of 123456789");
+	std::string text(1000, 0);
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		text[i] = (char)(i * 7 + 3);
+	}
+	uint32_t whole = TvChecksum::update(0, text.data(), text.size());
+	uint32_t first = TvChecksum::update(0, text.data(), 300);
+	uint32_t second = TvChecksum::update(0, text.data() + 300, 700);
+	check(TvChecksum::update(first, text.data() + 300, 700) == whole, "CRC-32C continued");
+	check(TvChecksum::combine(first, second, 700) == whole, "CRC-32C combined");
+	check(TvChecksum::combine(whole, 0, 0) == whole, "CRC-32C combined with nothing");
+	TvPortFileState state;
+	state.reset(1000);
+	state.addChecksum(300, 1000, second);
+	check(state.checksumSize == 0, "chunk after a gap waits");
+	state.addChecksum(0, 300, first);
+	check(state.checksumSize == 1000 && state.checksum == whole, "chunks summed out of order");
+	state.addChecksum(0, 300, first);
+	check(state.checksumSize < 0, "chunk sent again stops the sum");
+}
+
+// the journal cut by a power loss: the last line without its end is ignored, a broken line ends the replay
+static void checkJournalReplay()
+{
+	std::string path = (std::filesystem::temp_directory_path() / "tvport-check-journal.log").string();
+	{
+		std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		ofs << "C 123 7 1\nR 0 0 100 55\nP 1 0 50\nX 1\nF 0\nR 1 0 4";
+	}
+	std::vector<TvUploadJournalRecord> records;
+	{
+		TvUploadJournal journal(path);
+		check(journal.read(records), "journal read");
+	}
+	check(records.size() == 5, "torn last line ignored");
+	if (records.size() == 5)
+	{
+		check(records[0].type == 'C' && records[0].checksum == 123 && records[0].playlistId == 7 && records[0].activate == 1, "config record");
+		check(records[1].type == 'R' && records[1].fileNo == 0 && records[1].end == 100 && records[1].checksum == 55, "range record");
+		check(records[2].type == 'P' && records[2].fileNo == 1 && records[2].end == 50, "range record without the sum");
+		check(records[3].type == 'X' && records[3].fileNo == 1 && records[4].type == 'F' && records[4].fileNo == 0, "reset and file records");
+	}
+	{
+		std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		ofs << "C 123 7 1\nR 0 0\nF 0\n";
+	}
+	records.clear();
+	{
+		TvUploadJournal journal(path);
+		journal.read(records);
+	}
+	check(records.size() == 1, "replay stops at a broken line");
+	std::filesystem::remove(path);
+	records.clear();
+	TvUploadJournal disabled("");
+	check(!disabled.read(records) && records.empty(), "journal without a path reads as missing");
+}
+
+// the ETag of a slot file is taken from its name only when the name carries the check sum and the length
+static void checkNameTags()
+{
+	unsigned long long length = 0;
+	check(TvStaticFiles::getNameTag("1/i0_3808858755-4096.jpg", length) == "\"3808858755-4096\"" && length == 4096, "tag of a media file");
+	check(TvStaticFiles::getNameTag("2/v12_77-100.mp4", length) == "\"77-100\"", "tag of a video file");
+	check(TvStaticFiles::getNameTag("1/i0_3808858755-4096.jpg.part", length).empty(), "no tag of a .part file");
+	check(TvStaticFiles::getNameTag("1/v0_77-100.mp4.3808858755-4096.mp4", length).empty(), "no tag when the extension is not the last dot");
+	check(TvStaticFiles::getNameTag("1/i0_0-4096.jpg", length).empty(), "no tag of an unchecked file");
+	check(TvStaticFiles::getNameTag("1/i0_4294967296-4096.jpg", length).empty(), "no tag of a check sum over 32 bits");
+	check(TvStaticFiles::getNameTag("1/i0_77-.jpg", length).empty() && TvStaticFiles::getNameTag("1/index.html", length).empty(), "no tag of other names");
+	std::string tag = "\"77-100\"";
+	check(TvStaticFiles::matchesTag(tag, tag), "same tag matches");
+	check(TvStaticFiles::matchesTag("\"1-2\", W/\"77-100\"", tag), "weak tag in a list matches");
+	check(TvStaticFiles::matchesTag(" * ", tag), "any tag matches");
+	check(!TvStaticFiles::matchesTag("\"77-1000\"", tag) && !TvStaticFiles::matchesTag("", tag), "other tag does not match");
+}
+
+// tvport check: the checks of the upload bookkeeping and of the file names, returns the number of the failed checks
+int runChecks()
+{
+	failedChecks = 0;
+	checkFileRanges();
+	checkChecksums();
+	checkJournalReplay();
+	checkNameTags();
+	std::cout << (failedChecks == 0 ? "all checks passed" : std::to_string(failedChecks) + " checks failed") << std::endl;
+	return failedChecks;
+}
@@ -0,0 +1,9 @@
+#ifndef TVPORT_TEST_HPP
+#define TVPORT_TEST_HPP
+#include <string>
+
+int mainTest();
+int benchmarkPictureDecoding(std::string imagePath, int rounds);
+int runChecks();
+
+#endif
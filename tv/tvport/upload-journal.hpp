@@ -0,0 +1,282 @@
+/*************************************************************
+TvUploadJournal is the append-only log of the uploads of one slot (TVPORT_JOURNAL_FILE in the slot folder),
+so after a restart or a power cut the slot continues from the journal, without reading the files again.
+Every record is one line:
+  C <crc> <id> <activate>     a new config: its CRC-32C, its playlist id and whether it is shown when ready,
+                              the journal starts again with it
+  R <file> <start> <end> <crc>  the range arrived and its check sum
+  P <file> <start> <end>      the range is on the disk, but its check sum is not known
+  X <file>                    the file failed its check sum and is uploaded again
+  F <file>                    the file is complete, checked and has got its name
+  V                           all files of the slot are complete
+The journal is synced in batches: after TVPORT_JOURNAL_BATCH records or TVPORT_JOURNAL_SYNC_MS,
+and at once after C, F and V. The .part files written since the last sync are synced before the journal,
+so a range in the journal is always on the disk. The records after the last sync may be lost, those ranges are sent again.
+The records of the ranges are only collected under uploadMutex of the slot, the batch is flushed by syncIfDue
+after the chunk has released uploadMutex, so the other chunks of the slot do not wait for the disk.
+A flush takes the records and the .part files collected so far, syncs the files and then writes and syncs the records.
+A line without its end (cut by the power) and everything after it is ignored.
+A journal made with an empty path records nothing and reads as missing, slot 0 has none, its folder is the public web root.
+**************************************************************/
+
+#ifndef TVPORT_UPLOAD_JOURNAL_HPP
+#define TVPORT_UPLOAD_JOURNAL_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define TVPORT_JOURNAL_FILE "journal.log"
+#define TVPORT_JOURNAL_BATCH 64
+#define TVPORT_JOURNAL_SYNC_MS 1000
+
+struct TvUploadJournalRecord {
+	char type = 0;
+	int fileNo = -1;
+	long long start = 0;
+	long long end = 0;
+	unsigned long long checksum = 0;
+	int playlistId = 0;
+	int activate = 1;
+};
+
+class TvUploadJournal
+{
+	std::string journalPath;
+	// guards the collected records and files
+	std::mutex journalMutex;
+	std::string pendingLines;
+	int unsynced = 0;
+	std::chrono::steady_clock::time_point lastSync;
+	std::set<std::string> dirtyFiles;
+	// one flush at a time, so the batches reach the journal in their order, it guards journalFile too
+	std::mutex syncMutex;
+	FILE* journalFile = nullptr;
+
+	static void syncFile(FILE* fp)
+	{
+		fflush(fp);
+#ifdef _WIN32
+		_commit(_fileno(fp));
+#else
+		fsync(fileno(fp));
+#endif
+	}
+
+	bool open(const char* mode)
+	{
+		if (journalPath.empty())
+		{
+			return false;
+		}
+		if (journalFile != nullptr)
+		{
+			fclose(journalFile);
+		}
+		if (fopen_s(&journalFile, journalPath.c_str(), mode) != 0)
+		{
+			journalFile = nullptr;
+		}
+		return journalFile != nullptr;
+	}
+
+	void append(const std::string& line, bool important, const std::string& partName = "")
+	{
+		if (journalPath.empty())
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(journalMutex);
+			pendingLines += line;
+			if (!partName.empty())
+			{
+				dirtyFiles.insert(partName);
+			}
+			unsynced++;
+		}
+		if (important)
+		{
+			sync();
+		}
+	}
+
+public:
+	TvUploadJournal(const std::string& path) : journalPath(path), lastSync(std::chrono::steady_clock::now())
+	{
+	}
+
+	TvUploadJournal(const TvUploadJournal&) = delete;
+	TvUploadJournal& operator=(const TvUploadJournal&) = delete;
+
+	~TvUploadJournal()
+	{
+		close();
+	}
+
+	// the records which come after it open the journal again
+	void close()
+	{
+		sync();
+		std::lock_guard<std::mutex> syncLock(syncMutex);
+		if (journalFile != nullptr)
+		{
+			fclose(journalFile);
+			journalFile = nullptr;
+		}
+	}
+
+	// the data of the recorded ranges first, then the records
+	void sync()
+	{
+		std::lock_guard<std::mutex> syncLock(syncMutex);
+		std::set<std::string> files;
+		std::string lines;
+		{
+			std::lock_guard<std::mutex> lock(journalMutex);
+			files.swap(dirtyFiles);
+			lines.swap(pendingLines);
+			unsynced = 0;
+			lastSync = std::chrono::steady_clock::now();
+		}
+		for (const std::string& name : files)
+		{
+			FILE* fp;
+			if (fopen_s(&fp, name.c_str(), "r+b") == 0)
+			{
+				syncFile(fp);
+				fclose(fp);
+			}
+		}
+		if (lines.empty() || (journalFile == nullptr && !open("ab")))
+		{
+			return;
+		}
+		fputs(lines.c_str(), journalFile);
+		syncFile(journalFile);
+	}
+
+	// flushes the batch when it is full or old enough, called without holding uploadMutex
+	void syncIfDue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(journalMutex);
+			if (unsynced == 0 || (unsynced < TVPORT_JOURNAL_BATCH
+				&& std::chrono::steady_clock::now() - lastSync <= std::chrono::milliseconds(TVPORT_JOURNAL_SYNC_MS)))
+			{
+				return;
+			}
+		}
+		sync();
+	}
+
+	void recordConfig(uint32_t configChecksum, int playlistId, bool activate)
+	{
+		{
+			std::lock_guard<std::mutex> syncLock(syncMutex);
+			{
+				std::lock_guard<std::mutex> lock(journalMutex);
+				dirtyFiles.clear();
+				pendingLines.clear();
+				unsynced = 0;
+			}
+			if (!open("wb"))
+			{
+				return;
+			}
+		}
+		append("C " + std::to_string(configChecksum) + " " + std::to_string(playlistId) + " " + (activate ? "1" : "0") + "\n", true);
+	}
+
+	void recordRange(int fileNo, long long start, long long end, const std::string& partName)
+	{
+		append("P " + std::to_string(fileNo) + " " + std::to_string(start) + " " + std::to_string(end) + "\n", false, partName);
+	}
+
+	void recordRange(int fileNo, long long start, long long end, uint32_t checksum, const std::string& partName)
+	{
+		append("R " + std::to_string(fileNo) + " " + std::to_string(start) + " " + std::to_string(end) + " " + std::to_string(checksum) + "\n", false, partName);
+	}
+
+	void recordReset(int fileNo)
+	{
+		append("X " + std::to_string(fileNo) + "\n", false);
+	}
+
+	// important is false, when several files are recorded together, sync is called after them
+	void recordFile(int fileNo, bool important)
+	{
+		append("F " + std::to_string(fileNo) + "\n", important);
+	}
+
+	void recordVerified()
+	{
+		append("V\n", true);
+	}
+
+	// the records of the journal, false when there is no journal
+	bool read(std::vector<TvUploadJournalRecord>& records)
+	{
+		if (journalPath.empty())
+		{
+			return false;
+		}
+		std::ifstream ifs(journalPath, std::ios::in | std::ios::binary);
+		if (!ifs.is_open())
+		{
+			return false;
+		}
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			if (ifs.eof())
+			{
+				// the last line has no end, it was cut
+				break;
+			}
+			TvUploadJournalRecord record;
+			record.type = line.empty() ? 0 : line.at(0);
+			const char* rest = line.c_str() + (line.empty() ? 0 : 1);
+			bool valid;
+			switch (record.type)
+			{
+			case 'C':
+				valid = sscanf_s(rest, "%llu %d %d", &record.checksum, &record.playlistId, &record.activate) >= 1;
+				break;
+			case 'R':
+				valid = sscanf_s(rest, "%d %lld %lld %llu", &record.fileNo, &record.start, &record.end, &record.checksum) == 4;
+				break;
+			case 'P':
+				valid = sscanf_s(rest, "%d %lld %lld", &record.fileNo, &record.start, &record.end) == 3;
+				break;
+			case 'X':
+			case 'F':
+				valid = sscanf_s(rest, "%d", &record.fileNo) == 1;
+				break;
+			case 'V':
+				valid = true;
+				break;
+			default:
+				valid = false;
+			}
+			if (!valid)
+			{
+				break;
+			}
+			records.push_back(record);
+		}
+		return true;
+	}
+};
+
+#endif
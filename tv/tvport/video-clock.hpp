@@ -0,0 +1,107 @@
+/*************************************************************
+TvVideoClock is the presentation clock of the played video.
+It is started when the first frame is shown, after that every frame is due at
+start + (timestamp of the frame - timestamp of the first frame),
+so the playback speed follows the frame rate of the video and not the speed of decoding.
+
+The decode thread asks getLateness before it decodes the next frame and only grabs (skips) the frames
+which are already late, the render thread drops the frames which became late while waiting in the ring.
+Both of them count what they did, and the statistics (drift of the shown frames and the dropped frames)
+are printed when the video ends.
+**************************************************************/
+
+#ifndef TVPORT_VIDEO_CLOCK_HPP
+#define TVPORT_VIDEO_CLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// in fps, used when the container does not report a sensible frame rate
+#define VIDEO_DEFAULT_FPS 25.0
+#define VIDEO_MAXIMUM_FPS 240.0
+
+class TvVideoClock
+{
+	std::chrono::steady_clock::time_point startTime;
+	double startTimestamp = 0;
+	std::atomic<bool> started{ false };
+	double frameDuration;
+
+	std::atomic<long> presentedFrames{ 0 }, droppedFrames{ 0 }, skippedFrames{ 0 };
+	double totalDrift = 0, maximumDrift = 0;
+
+public:
+	TvVideoClock(double fps)
+	{
+		if (fps <= 0 || fps > VIDEO_MAXIMUM_FPS)
+		{
+			fps = VIDEO_DEFAULT_FPS;
+		}
+		frameDuration = 1000.0 / fps;
+	}
+
+	// in ms
+	double getFrameDuration()
+	{
+		return frameDuration;
+	}
+
+	void start(double timestamp)
+	{
+		startTimestamp = timestamp;
+		startTime = std::chrono::steady_clock::now();
+		started.store(true, std::memory_order_release);
+	}
+
+	bool isStarted()
+	{
+		return started.load(std::memory_order_acquire);
+	}
+
+	// in ms, positive when the frame with this timestamp is already late, negative when it is early
+	double getLateness(double timestamp)
+	{
+		if (!isStarted())
+		{
+			return 0;
+		}
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		return elapsed - (timestamp - startTimestamp);
+	}
+
+	// called by the render thread only
+	void countPresented(double drift)
+	{
+		presentedFrames++;
+		double absDrift = drift < 0 ? -drift : drift;
+		totalDrift += absDrift;
+		if (absDrift > maximumDrift)
+		{
+			maximumDrift = absDrift;
+		}
+	}
+
+	// the frame was decoded, but it was late to be shown
+	void countDropped()
+	{
+		droppedFrames++;
+	}
+
+	// the frame was late already before decoding, so it was only grabbed
+	void countSkipped()
+	{
+		skippedFrames++;
+	}
+
+	void printStatistics(std::string fileName)
+	{
+		long presented = presentedFrames.load();
+		std::cout << "Video " << fileName << " fps=" << 1000.0 / frameDuration << " presented=" << presented
+			<< " dropped=" << droppedFrames.load() << " skipped=" << skippedFrames.load()
+			<< " average drift=" << (presented > 0 ? totalDrift / presented : 0) << "ms maximum drift=" << maximumDrift << "ms" << std::endl;
+	}
+};
+
+#endif